@@ -0,0 +1,27 @@
+#ifndef _ACTOR_H
+#define _ACTOR_H
+
+/* How fast actors walk in blocks a second and turn in radians a second. */
+#define ACTOR_SPEED                     (1.5f)
+#define ACTOR_TURN_SPEED                (2.0f)
+/* Actors turn away from anyone closer than this in front of them. It has to stay
+ * under a block so that only the cells right around an actor need looking at. */
+#define ACTOR_SPACING                   (0.75f)
+/* How many actors a worker takes at a time when ticking. */
+#define ACTOR_CHUNK                     (256)
+/* The most neighbours that one actor looks at when deciding where to go. */
+#define ACTOR_MAX_NEIGHBOURS            (16)
+/* Maps with at most this many cells for every actor there is room for get a grid bucket
+ * for every cell. Bigger maps share the buckets out between the cells. */
+#define ACTOR_GRID_CELLS                (16)
+
+int actor_init(int capacity, int workers);
+void actor_free(void);
+int actor_add(float x, float y, float angle);
+int actor_get_count(void);
+void actor_tick(float delta_time);
+float actor_get_tick_time(void);
+int actor_find(float x, float y, float radius, int* found, int max);
+int actor_copy_positions(float* x, float* y);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#define BENCH_DEFAULT_FRAMES            (1000)
+#define BENCH_DELTA_TIME                (1.0f/60.0f)
+
+/* Options for a benchmark run. */
+typedef struct {
+    int frames;
+    /* A file with the input to play back, or NULL to use the built in path. */
+    const char* script;
+    /* Where to write the results as JSON, or NULL to skip it. */
+    const char* json;
+    /* How many cameras to draw every frame. The first one is the demo camera and the
+     * rest look around it in even steps. */
+    int views;
+} bench_config;
+
+int bench_run(const bench_config* config);
+/* Anything else that times itself can sort its times and pull percentiles out of
+ * them the same way the benchmark does. */
+void bench_sort(double* times, int count);
+double bench_percentile(const double* sorted, int count, double percent);
+
+#endif
\ No newline at end of file
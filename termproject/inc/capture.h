@@ -0,0 +1,17 @@
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include "gfx.h"
+
+/* How many frames can be waiting to be written before new ones get dropped. */
+#define CAPTURE_BUFFERS                 (8)
+/* How much gets collected before it goes out to the disk in one write. */
+#define CAPTURE_WRITE_SIZE              (1 << 20)
+
+int capture_start(const char* fname, int width, int height, int rate);
+int capture_stop(void);
+void capture_frame(const gfx_color* pixels, int pitch, int width, int height);
+int capture_get_written(void);
+int capture_get_dropped(void);
+
+#endif
\ No newline at end of file
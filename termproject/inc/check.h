@@ -0,0 +1,8 @@
+#ifndef _CHECK_H
+#define _CHECK_H
+
+/* Every check sets up whatever it needs and tears it down again, so they have to run
+ * before anything else gets loaded. Returns 0 if they all passed. */
+int check_run(void);
+
+#endif
\ No newline at end of file
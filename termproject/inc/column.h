@@ -0,0 +1,31 @@
+#ifndef _COLUMN_H
+#define _COLUMN_H
+
+#include "fixed.h"
+#include "shade.h"
+
+/* Whether a bitmap has see through texels that leave what is behind them. */
+#define COLUMN_OPAQUE                   (0)
+#define COLUMN_MASKED                   (1)
+#define COLUMN_FORMATS                  (2)
+/* Black and full brightness do not need the shade tables at all. */
+#define COLUMN_DARK                     (0)
+#define COLUMN_SHADED                   (1)
+#define COLUMN_FULL                     (2)
+#define COLUMN_LIGHTS                   (3)
+
+/* Which kind of lighting a shade level needs. */
+#define COLUMN_LIGHT(level)             ((level) <= 0 ? COLUMN_DARK : (level) >= SHADE_LEVELS - 1 ? COLUMN_FULL : COLUMN_SHADED)
+
+/* Draws count pixels down a column of the framebuffer starting at pixel, stepping
+ * through the texels of a bitmap column from current by step for every pixel. */
+typedef void (*column_kernel)(gfx_color* pixel, int pitch, int count, const gfx_color* texels, float current, float step, const unsigned char* shade);
+/* The same with current and step in 16.16 fixed point. */
+typedef void (*column_fixed_kernel)(gfx_color* pixel, int pitch, int count, const gfx_color* texels, unsigned int current, unsigned int step, const unsigned char* shade);
+
+int column_pick(int bitmap);
+void column_free(void);
+column_kernel column_get(int bitmap, int level, int light);
+column_fixed_kernel column_get_fixed(int bitmap, int level, int light);
+
+#endif
\ No newline at end of file
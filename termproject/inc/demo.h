@@ -1,6 +1,8 @@
 #ifndef _DEMO_H
 #define _DEMO_H
 
+#include "ray.h"
+
 #define DEMO_TITLE                      ("Term Project")
 #define DEMO_WIDTH                      (320)
 #define DEMO_HEIGHT                     (240)
@@ -9,10 +11,53 @@
 #define DEMO_INPUT_DOWN                 (1)
 #define DEMO_INPUT_LEFT                 (2)
 #define DEMO_INPUT_RIGHT                (3)
+/* Knocks out the wall in front of the camera, or puts one up if there is none. */
+#define DEMO_INPUT_USE                  (4)
+#define DEMO_INPUTS                     (5)
+#define DEMO_DEFAULT_SPRITES            (64)
+
+/* Options for how the demo should run. */
+typedef struct {
+    int workers;
+    int isa;
+    /* A map file to load, or NULL to use a generated map of map_size or the built in level. */
+    const char* map;
+    int map_size;
+    /* A bundle of bitmaps to use instead of loading them one at a time, or NULL. */
+    const char* bundle;
+    /* How far away things fade out to black, or 0 for the default. */
+    float max_light;
+    /* How many sprites to scatter around the map. */
+    int sprites;
+    /* The largest the screen gets drawn at, or 0 for DEMO_WIDTH by DEMO_HEIGHT. */
+    int width;
+    int height;
+    /* Whether to draw with the fixed point renderer to begin with. */
+    int fixed_point;
+} demo_config;
+
+/* A camera to draw and the pixels to draw it into, height rows of pitch pixels each. */
+typedef struct {
+    ray_camera camera;
+    gfx_color* pixels;
+    int pitch;
+    int width, height;
+} demo_view;
 
-void demo_init(void);
+int demo_init(const demo_config* config);
 void demo_free(void);
+void demo_set_max_light(float max_light);
+void demo_set_fixed_point(int fixed_point);
+int demo_get_fixed_point(void);
+void demo_set_resolution(int width, int height);
+int demo_get_width(void);
+int demo_get_height(void);
+int demo_get_workers(void);
+void demo_move_camera(ray_camera* camera, float delta_time, const int* keys);
 void demo_tick(float delta_time, int* keys);
+void demo_get_camera(ray_camera* camera);
 void demo_draw(void);
+void demo_draw_camera(const ray_camera* camera);
+int demo_draw_views(const demo_view* views, int count);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef _FIXED_H
+#define _FIXED_H
+
+/* Numbers in 16.16 fixed point, the top 16 bits are the whole part and the bottom 16
+ * bits are the fraction. Everything done with them is whole number math so the same
+ * inputs give the same bits on any compiler and any processor. */
+typedef int fixed;
+
+#define FIXED_SHIFT                     (16)
+#define FIXED_ONE                       (1 << FIXED_SHIFT)
+#define FIXED_FRACTION                  (FIXED_ONE - 1)
+#define FIXED_MAX                       (0x7FFFFFFF)
+/* How many of the top bits of a number pick its reciprocal out of the table. Dividing
+ * is done by multiplying with one of those, and since it is a ratio the two numbers
+ * can just as well both be whole numbers as both be fixed point. */
+#define FIXED_RECIPROCAL_BITS           (12)
+
+#define FIXED_FROM_INT(i)               ((fixed)((i) * FIXED_ONE))
+/* Rounds down, including for negative numbers. */
+#define FIXED_TO_INT(f)                 ((f) >> FIXED_SHIFT)
+#define FIXED_MUL(a, b)                 ((fixed)(((long long)(a) * (b)) >> FIXED_SHIFT))
+
+void fixed_init(void);
+fixed fixed_from_float(float value);
+float fixed_to_float(fixed value);
+fixed fixed_divide(fixed numerator, fixed denominator);
+fixed fixed_reciprocal(fixed value);
+fixed fixed_length(fixed x, fixed y);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef _FMAP_H
+#define _FMAP_H
+
+#include <stddef.h>
+
+/* A read only view of a whole file mapped into memory. The operating system
+ * pages the data in as it gets touched instead of us reading all of it up front. */
+typedef struct {
+    const void* data;
+    size_t size;
+    void* handle;
+    void* mapping;
+} fmap_file;
+
+int fmap_open(const char* fname, fmap_file* file);
+void fmap_close(fmap_file* file);
+
+#endif
\ No newline at end of file
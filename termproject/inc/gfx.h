@@ -1,13 +1,52 @@
 #ifndef _GFX_H
 #define _GFX_H
 
-#define GFX_MAX_TEXTURES                (5)
+/* Bitmaps keep the file they came from, this long including the terminator. */
+#define GFX_NAME_SIZE                   (32)
+/* Enough levels for a 32768 texel wide bitmap. */
+#define GFX_MAX_MIP_LEVELS              (16)
 
+/* Pack a color into the framebuffer's 32-bit ARGB format. */
+#define GFX_RGB(r, g, b)                (0xFF000000u | ((unsigned int)(r) << 16) | ((unsigned int)(g) << 8) | (unsigned int)(b))
+/* Only bitmaps with see through parts like sprites use anything other than a solid alpha. */
+#define GFX_ARGB(a, r, g, b)            (((unsigned int)(a) << 24) | ((unsigned int)(r) << 16) | ((unsigned int)(g) << 8) | (unsigned int)(b))
+#define GFX_ALPHA(c)                    (((c) >> 24) & 0xFF)
+#define GFX_RED(c)                      (((c) >> 16) & 0xFF)
+#define GFX_GREEN(c)                    (((c) >> 8) & 0xFF)
+#define GFX_BLUE(c)                     ((c) & 0xFF)
+
+/* The width or height of a bitmap at a level of its mip chain. Each level is half
+ * the size of the one before it until it gets down to a single texel. */
+#define GFX_MIP_SIZE(size, level)       ((size) >> (level) > 0 ? (size) >> (level) : 1)
+
+typedef unsigned int gfx_color;
+
+int gfx_init(int width, int height);
+void gfx_free(void);
+void gfx_present(void);
+void gfx_swap(void);
+void gfx_set_size(int width, int height);
+gfx_color* gfx_get_framebuffer(int* pitch);
+
+int gfx_create_bitmap(int width, int height, const gfx_color* texels, int pitch);
 int gfx_generate_bitmap(const char* fname);
+int gfx_load_bundle(const char* fname);
+int gfx_save_bundle(const char* fname);
+int gfx_find_bitmap(const char* name);
 void gfx_free_bitmap(int index);
+int gfx_get_bitmap_count(void);
+int gfx_get_bitmap_slots(void);
+int gfx_get_bitmap_masked(int index);
 int gfx_get_bitmap_width(int index);
 int gfx_get_bitmap_height(int index);
+const gfx_color* gfx_get_bitmap_pixels(int index, int* pitch);
+const gfx_color* gfx_get_bitmap_column(int index, int x);
+int gfx_get_bitmap_levels(int index);
+const gfx_color* gfx_get_bitmap_mip_column(int index, int level, int x);
+const gfx_color* gfx_get_bitmap_mip(int index, int level);
 void gfx_get_bitmap_color(int index, int x, int y, int* r, int* g, int* b);
 void gfx_putpixel(int x, int y, int r, int g, int b);
+void gfx_putcolumn(int x, int y, int count, const gfx_color* colors);
+void gfx_putspan(int x, int y, int count, const gfx_color* colors);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef _MAP_H
+#define _MAP_H
+
+/* The map is stored as one byte per cell, grouped into square tiles so that the
+ * cells around any spot are close together in memory no matter which way a ray
+ * is heading. A 16x16 tile is 256 bytes, only a few cache lines. */
+#define MAP_TILE_SHIFT                  (4)
+#define MAP_TILE_SIZE                   (1 << MAP_TILE_SHIFT)
+#define MAP_TILE_MASK                   (MAP_TILE_SIZE - 1)
+/* Extra zero bytes after the last tile so vector code can read a little past it. */
+#define MAP_PADDING                     (16)
+#define MAP_MAX_SIZE                    (16384)
+/* The distance field stops counting at this many cells. */
+#define MAP_DISTANCE_MAX                (32)
+/* How many changes can be queued up waiting for the next frame. */
+#define MAP_MAX_EDITS                   (256)
+
+/* Where the cell at x, y lives in the tiled cell array. */
+#define MAP_INDEX(tiles_x, x, y)        (((((y) >> MAP_TILE_SHIFT) * (tiles_x) + ((x) >> MAP_TILE_SHIFT)) << (2 * MAP_TILE_SHIFT)) \
+                                        | (((y) & MAP_TILE_MASK) << MAP_TILE_SHIFT) | ((x) & MAP_TILE_MASK))
+
+/* Every cell also says what the floor and ceiling in it look like. These are bitmaps
+ * counted from 1 the same way that the walls are, with 0 meaning a plain color. Maps
+ * from before these were added have neither and get plain floors and ceilings.
+ *
+ * Alongside the cells we keep a distance field in the same tiled layout. For every
+ * cell it says how far it is to the closest solid cell, counting diagonal steps as
+ * one, so a cell with a distance of d has nothing but empty space for d - 1 cells
+ * in every direction. Solid cells have a distance of 0 and the outside of the map
+ * counts as solid.
+ *
+ * A map file gets copied into memory that we own as soon as it is loaded, so the
+ * cells never move once the game is running. Changing a cell does still rewrite it
+ * and the distance field around it in place, which the threads that draw and tick
+ * could not cope with, so none of them can be running while any of the map_set
+ * functions are called. While they are running the simulation queues up changes
+ * with map_queue_set instead and they get applied between frames with
+ * map_apply_edits, at a point where nothing is drawing or ticking. */
+typedef struct {
+    const unsigned char* cells;
+    const unsigned char* floors;
+    const unsigned char* ceilings;
+    const unsigned char* distance;
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+    float spawn_x;
+    float spawn_y;
+} map_data;
+
+int map_load(const char* fname);
+int map_save(const char* fname);
+int map_create(int width, int height);
+int map_generate(int width, int height, unsigned int seed);
+void map_free(void);
+int map_build_distance(void);
+const map_data* map_get_data(void);
+int map_get(int x, int y);
+void map_set(int x, int y, int value);
+int map_get_floor(int x, int y);
+int map_get_ceiling(int x, int y);
+void map_set_floor(int x, int y, int value);
+void map_set_ceiling(int x, int y, int value);
+void map_set_spawn(float x, float y);
+int map_queue_set(int x, int y, int value);
+int map_get_edit_count(void);
+void map_apply_edits(void);
+
+#endif
\ No newline at end of file
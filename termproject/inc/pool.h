@@ -0,0 +1,16 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+/* A job gets handed a range of items [begin, end) to work on. */
+typedef void (*pool_job)(void* data, int begin, int end);
+
+/* A set of worker threads that share out one job at a time. Anything that needs
+ * its jobs done on time no matter what else is going on gets a pool of its own. */
+typedef struct pool pool;
+
+pool* pool_create(int workers);
+void pool_free(pool* p);
+int pool_get_workers(const pool* p);
+void pool_run(pool* p, pool_job job, void* data, int count, int chunk);
+
+#endif
\ No newline at end of file
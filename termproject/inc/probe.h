@@ -0,0 +1,17 @@
+#ifndef _PROBE_H
+#define _PROBE_H
+
+#include <SDL.h>
+
+/* How many key changes can be waiting on a frame before the oldest ones are given up on. */
+#define PROBE_PENDING                   (64)
+/* How many of the most recent measurements get kept for the report. */
+#define PROBE_MAX_SAMPLES               (4096)
+
+void probe_input(void);
+void probe_publish(void);
+int probe_latch(Uint64* latch_time);
+void probe_present(int latched, Uint64 latch_time);
+void probe_report(void);
+
+#endif
\ No newline at end of file
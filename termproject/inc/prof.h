@@ -0,0 +1,39 @@
+#ifndef _PROF_H
+#define _PROF_H
+
+/* Timing zones for finding out where the time in a frame goes. They are only
+ * compiled in when PROF_ENABLED is defined, otherwise every one of these turns
+ * into nothing. A zone gets started and ended in the same block:
+ *
+ *     PROF_BEGIN(draw);
+ *     demo_draw();
+ *     PROF_END(draw, "demo_draw");
+ *
+ * Every thread records into its own ring buffer so there is no locking, and the
+ * whole thing can be written out at the end as a Chrome trace (chrome://tracing). */
+#ifdef PROF_ENABLED
+
+#include <SDL.h>
+
+#define PROF_BEGIN(zone)                Uint64 zone = SDL_GetPerformanceCounter()
+#define PROF_END(zone, name)            prof_record((name), (zone), SDL_GetPerformanceCounter())
+#define PROF_THREAD(name)               prof_name_thread(name)
+#define PROF_DUMP(fname)                prof_dump(fname)
+#define PROF_FREE()                     prof_free()
+
+void prof_record(const char* name, Uint64 start, Uint64 end);
+void prof_name_thread(const char* name);
+int prof_dump(const char* fname);
+void prof_free(void);
+
+#else
+
+#define PROF_BEGIN(zone)
+#define PROF_END(zone, name)            ((void)0)
+#define PROF_THREAD(name)               ((void)0)
+#define PROF_DUMP(fname)                ((void)0)
+#define PROF_FREE()                     ((void)0)
+
+#endif
+
+#endif
\ No newline at end of file
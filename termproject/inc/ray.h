@@ -0,0 +1,77 @@
+#ifndef _RAY_H
+#define _RAY_H
+
+#include "fixed.h"
+#include "gfx.h"
+#include "map.h"
+
+#define RAY_ISA_AUTO                    (-1)
+#define RAY_ISA_SCALAR                  (0)
+#define RAY_ISA_SSE2                    (1)
+#define RAY_ISA_AVX2                    (2)
+/* How far a ray goes looking for a wall before it gives up. */
+#define RAY_MAX_DISTANCE                (64.0f)
+/* How far apart the sides are along an axis that a ray does not move along at all.
+ * It only has to be further than any ray will ever go. */
+#define RAY_NEVER                       (1e30f)
+/* The fixed point rays can only go so far. The sides that they never reach are as far
+ * apart as they can be while going that far past one still fits in 32 bits. */
+#define RAY_FIXED_MAX_DISTANCE          (256)
+#define RAY_FIXED_NEVER                 FIXED_FROM_INT(64 * RAY_FIXED_MAX_DISTANCE)
+
+/* How far along the ray the next side in one direction is after stepping over a
+ * number of blocks in that direction. Working it out from the number of steps rather
+ * than adding up the steps one at a time means that we get the same answer however
+ * we got there, which is what lets a ray jump over empty space and still hit exactly
+ * the same wall. Every kernel has to do it this exact way. */
+#define RAY_SIDE_DIST(first, steps, delta) ((first) + (float)(steps) * (delta))
+
+/* Where the camera is and where it is looking. */
+typedef struct {
+    float x, y;
+    float dir_x, dir_y;
+    float plane_x, plane_y;
+} ray_camera;
+
+/* The same camera in 16.16 fixed point. */
+typedef struct {
+    fixed x, y;
+    fixed dir_x, dir_y;
+    fixed plane_x, plane_y;
+} ray_fixed_camera;
+
+/* Everything that the drawing code needs to know about where the ray for
+ * one screen column ended up. The cell is 0 if the ray never found a wall. */
+typedef struct {
+    float ray_dir_x, ray_dir_y;
+    float perp_wall_dist;
+    float wall_x;
+    int map_x, map_y;
+    int cell;
+    int side;
+    int line_height;
+    /* The distance and the spot along the wall again in fixed point. Only the fixed
+     * point rays fill these in, and the floats above are made from them. */
+    fixed fixed_perp_wall_dist;
+    fixed fixed_wall_x;
+} ray_hit;
+
+/* The world that the rays get traced through. It is only read while casting. The
+ * distance field is optional, without it the rays visit every block. */
+typedef struct {
+    const unsigned char* cells;
+    const unsigned char* distance;
+    int map_width, map_height;
+    int tiles_x;
+    float max_distance;
+} ray_world;
+
+void ray_set_map(const map_data* map);
+void ray_set_max_distance(float max_distance);
+int ray_select_isa(int isa);
+int ray_get_isa(void);
+void ray_cast(const ray_camera* camera, int width, int height, int begin, int end, ray_hit* hits);
+void ray_camera_to_fixed(const ray_camera* camera, ray_fixed_camera* fixed_camera);
+void ray_cast_fixed(const ray_camera* camera, int width, int height, int begin, int end, ray_hit* hits);
+
+#endif
\ No newline at end of file
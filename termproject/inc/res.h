@@ -0,0 +1,20 @@
+#ifndef _RES_H
+#define _RES_H
+
+/* The screen never gets scaled down past this fraction of its full size on either side. */
+#define RES_MIN_SCALE                   (0.5f)
+/* Each change moves a side by this fraction of its full size. */
+#define RES_STEP_SCALE                  (0.0625f)
+/* Drop the resolution once drawing takes more than this much of the budget and
+ * raise it again once it takes less than this much. */
+#define RES_HIGH_WATER                  (0.9f)
+#define RES_LOW_WATER                   (0.6f)
+/* How many frames to wait after a change before judging it. */
+#define RES_SETTLE_FRAMES               (8)
+
+void res_init(int max_width, int max_height, float budget);
+void res_update(float draw_time);
+int res_get_width(void);
+int res_get_height(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _SHADE_H
+#define _SHADE_H
+
+#include "fixed.h"
+#include "gfx.h"
+
+/* How many different brightnesses things can be drawn at, from black up to full. */
+#define SHADE_LEVELS                    (64)
+/* Distances are looked up in steps of a sixteenth of a block out to the furthest
+ * that a ray can go. Anything past that is black. */
+#define SHADE_DISTANCE_STEPS            (16)
+#define SHADE_MAX_DISTANCE              (64)
+#define SHADE_DEFAULT_MAX_LIGHT         (10.0f)
+
+/* Shade a color using the table for one level, which is one lookup per channel. */
+#define SHADE_COLOR(table, c)           GFX_RGB((table)[GFX_RED(c)], (table)[GFX_GREEN(c)], (table)[GFX_BLUE(c)])
+
+void shade_set_max_light(float max_light);
+float shade_get_max_light(void);
+int shade_get_level(float distance);
+int shade_get_level_fixed(fixed distance);
+const unsigned char* shade_get_table(int level);
+gfx_color shade_color(gfx_color color, int level);
+
+#endif
\ No newline at end of file
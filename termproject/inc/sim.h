@@ -0,0 +1,19 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+#include "ray.h"
+
+/* The simulation always moves forward in steps of the same size no matter how
+ * long the frames take to draw. */
+#define SIM_TICK_RATE                   (60)
+#define SIM_STEP                        (1.0f / SIM_TICK_RATE)
+/* How many steps behind the simulation can fall before it stops trying to catch up. */
+#define SIM_MAX_CATCH_UP                (5)
+
+int sim_start(void);
+void sim_stop(void);
+void sim_set_keys(const int* keys);
+void sim_get_camera(ray_camera* camera);
+void sim_apply_edits(void);
+
+#endif
\ No newline at end of file
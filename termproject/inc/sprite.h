@@ -0,0 +1,47 @@
+#ifndef _SPRITE_H
+#define _SPRITE_H
+
+#include "ray.h"
+
+/* Sprites closer than this to the camera plane are treated as being behind it. */
+#define SPRITE_NEAR                     (0.1f)
+/* Culling compares sprites against the furthest wall in tiles of this many columns. */
+#define SPRITE_DEPTH_TILE               (8)
+
+/* What one camera can see of the sprites. The sprites themselves are shared but
+ * every view that gets drawn at the same time as another needs one of these. */
+typedef struct {
+    int capacity;
+    /* Where the sprites are for this view. They start out where the sprites were
+     * added but can be pointed somewhere else when something moves them around. */
+    const float* x;
+    const float* y;
+    /* How many sprites made it through culling, listed in visible furthest first. */
+    int count;
+    int* visible;
+    /* How far in front of the camera each sprite is, where it is across the screen,
+     * and for the visible ones where they go on the screen. */
+    float* ahead;
+    float* across;
+    int* left;
+    int* size;
+    /* Scratch space for the sort and the furthest wall in each tile of columns. */
+    unsigned int* keys;
+    int* order;
+    unsigned int* sort_keys;
+    int* sort_order;
+    float* tiles;
+    int tile_count;
+} sprite_view;
+
+int sprite_init(int capacity);
+void sprite_free(void);
+void sprite_clear(void);
+int sprite_add(float x, float y, int bitmap);
+int sprite_get_count(void);
+int sprite_view_init(sprite_view* view);
+void sprite_view_free(sprite_view* view);
+int sprite_cull(sprite_view* view, const ray_camera* camera, const float* depth, int width, int height);
+void sprite_draw(const sprite_view* view, gfx_color* pixels, int pitch, const float* depth, int width, int height, int begin, int end);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include "actor.h"
+#include "map.h"
+#include "pool.h"
+#include "prof.h"
+
+/* Everything about the actors that changes from one tick to the next, kept as a
+ * structure of arrays so each pass only streams through the fields it uses. Every
+ * actor has a direction and a camera plane just like the camera does, which means
+ * any of them can be looked through as well. */
+typedef struct {
+    float* x;
+    float* y;
+    float* dir_x;
+    float* dir_y;
+    float* plane_x;
+    float* plane_y;
+    /* Which way the actor is turning, -1, 0 or 1. */
+    float* turn;
+} actor_state;
+
+/* How far everything moves on this tick, worked out once for all of the actors. */
+typedef struct {
+    float delta_time;
+    float turn_cos;
+    float turn_sin;
+} actor_step;
+
+/* A tick reads the current state and writes the next one so that no actor sees
+ * another one half way through moving. It comes out the same no matter how the
+ * actors get split up between the workers. */
+static actor_state actor_states[2];
+static int actor_current = 0;
+static float* actor_speed = NULL;
+static int actor_count = 0;
+static int actor_capacity = 0;
+
+/* Where the actors in one bucket of the grid are listed. */
+typedef struct {
+    int start;
+    int count;
+} actor_bucket_range;
+
+/* A grid over the map with a cell for every block. On a map that is small next to
+ * how many actors there can be, every cell gets a bucket of its own. Otherwise the
+ * cells get hashed into at least twice as many buckets as there can be actors, so
+ * either way its size goes with the actors and not the map. The actors in a bucket
+ * are listed in the order they were added. A bucket can hold more than one cell, so
+ * the cell that each of them is in gets listed alongside. */
+static int* actor_cells = NULL;
+static int* actor_cell_items = NULL;
+static int* actor_cell_keys = NULL;
+static actor_bucket_range* actor_buckets = NULL;
+static unsigned int actor_bucket_mask = 0;
+static int actor_bucket_direct = 0;
+/* The buckets with anyone in them, which are the only ones that need emptying. */
+static int* actor_buckets_used = NULL;
+static int actor_bucket_used_count = 0;
+static int actor_grid_width = 0, actor_grid_height = 0;
+static int actor_grid_dirty = 1;
+
+/* The newest positions for whoever is drawing them. The tick fills in the back
+ * ones on its own and then swaps them to the front under the lock. */
+static float* actor_front_x = NULL;
+static float* actor_front_y = NULL;
+static float* actor_back_x = NULL;
+static float* actor_back_y = NULL;
+static SDL_mutex* actor_lock = NULL;
+
+static float actor_tick_time = 0.0f;
+/* The ticks get shared out over workers of their own. The frames are drawn on
+ * another pool, so a tick never has to wait for a frame to finish drawing and the
+ * simulation keeps to its own time no matter how long the frames take. */
+static pool* actor_pool = NULL;
+
+static int actor_alloc_state(actor_state* state, size_t n) {
+    state->x = (float*)malloc(n * sizeof(float));
+    state->y = (float*)malloc(n * sizeof(float));
+    state->dir_x = (float*)malloc(n * sizeof(float));
+    state->dir_y = (float*)malloc(n * sizeof(float));
+    state->plane_x = (float*)malloc(n * sizeof(float));
+    state->plane_y = (float*)malloc(n * sizeof(float));
+    state->turn = (float*)malloc(n * sizeof(float));
+    if (state->x == NULL || state->y == NULL || state->dir_x == NULL || state->dir_y == NULL ||
+        state->plane_x == NULL || state->plane_y == NULL || state->turn == NULL)
+        return -1;
+    return 0;
+}
+
+static void actor_free_state(actor_state* state) {
+    free(state->x);
+    free(state->y);
+    free(state->dir_x);
+    free(state->dir_y);
+    free(state->plane_x);
+    free(state->plane_y);
+    free(state->turn);
+    memset(state, 0, sizeof(actor_state));
+}
+
+int actor_init(int capacity, int workers) {
+    const map_data* map = map_get_data();
+    size_t n = capacity > 0 ? (size_t)capacity : 1;
+    size_t buckets = 1;
+
+    actor_free();
+    actor_grid_width = map->width;
+    actor_grid_height = map->height;
+    actor_bucket_direct = (size_t)actor_grid_width * actor_grid_height <= ACTOR_GRID_CELLS * n;
+    if (actor_bucket_direct) {
+        buckets = (size_t)actor_grid_width * actor_grid_height;
+    } else {
+        while (buckets < 2 * n)
+            buckets *= 2;
+    }
+    actor_bucket_mask = (unsigned int)buckets - 1;
+    actor_speed = (float*)malloc(n * sizeof(float));
+    actor_cells = (int*)malloc(n * sizeof(int));
+    actor_cell_items = (int*)malloc(n * sizeof(int));
+    actor_cell_keys = (int*)malloc(n * sizeof(int));
+    actor_buckets = (actor_bucket_range*)calloc(buckets, sizeof(actor_bucket_range));
+    actor_buckets_used = (int*)malloc(n * sizeof(int));
+    actor_front_x = (float*)malloc(n * sizeof(float));
+    actor_front_y = (float*)malloc(n * sizeof(float));
+    actor_back_x = (float*)malloc(n * sizeof(float));
+    actor_back_y = (float*)malloc(n * sizeof(float));
+    actor_lock = SDL_CreateMutex();
+    actor_pool = pool_create(workers);
+    if (actor_alloc_state(&actor_states[0], n) != 0 || actor_alloc_state(&actor_states[1], n) != 0 ||
+        actor_speed == NULL || actor_cells == NULL || actor_cell_items == NULL || actor_cell_keys == NULL ||
+        actor_buckets == NULL || actor_buckets_used == NULL || actor_front_x == NULL ||
+        actor_front_y == NULL || actor_back_x == NULL || actor_back_y == NULL || actor_lock == NULL || actor_pool == NULL) {
+        actor_free();
+        return -1;
+    }
+    actor_capacity = (int)n;
+    actor_current = 0;
+    actor_bucket_used_count = 0;
+    actor_grid_dirty = 1;
+    return 0;
+}
+
+void actor_free(void) {
+    actor_free_state(&actor_states[0]);
+    actor_free_state(&actor_states[1]);
+    free(actor_speed);
+    free(actor_cells);
+    free(actor_cell_items);
+    free(actor_cell_keys);
+    free(actor_buckets);
+    free(actor_buckets_used);
+    free(actor_front_x);
+    free(actor_front_y);
+    free(actor_back_x);
+    free(actor_back_y);
+    if (actor_lock != NULL)
+        SDL_DestroyMutex(actor_lock);
+    pool_free(actor_pool);
+    actor_speed = NULL;
+    actor_cells = NULL;
+    actor_cell_items = NULL;
+    actor_cell_keys = NULL;
+    actor_buckets = NULL;
+    actor_buckets_used = NULL;
+    actor_bucket_used_count = 0;
+    actor_front_x = actor_front_y = NULL;
+    actor_back_x = actor_back_y = NULL;
+    actor_lock = NULL;
+    actor_pool = NULL;
+    actor_count = 0;
+    actor_capacity = 0;
+}
+
+/* Actors can only be added before anything starts ticking or drawing them. */
+int actor_add(float x, float y, float angle) {
+    actor_state* state = &actor_states[actor_current];
+    int i = actor_count;
+
+    if (actor_count >= actor_capacity)
+        return -1;
+    state->x[i] = x;
+    state->y[i] = y;
+    state->dir_x[i] = cosf(angle);
+    state->dir_y[i] = sinf(angle);
+    /* The same field of view as the camera, off to the side of the direction. */
+    state->plane_x[i] = state->dir_y[i] * 0.66f;
+    state->plane_y[i] = -state->dir_x[i] * 0.66f;
+    state->turn[i] = 0.0f;
+    actor_speed[i] = ACTOR_SPEED;
+    actor_front_x[i] = actor_back_x[i] = x;
+    actor_front_y[i] = actor_back_y[i] = y;
+    actor_grid_dirty = 1;
+    return actor_count++;
+}
+
+int actor_get_count(void) {
+    return actor_count;
+}
+
+/* Which cell of the grid a spot is in, counting along the rows. */
+static void actor_cell(float x, float y, int* cell_x, int* cell_y) {
+    *cell_x = (int)x;
+    *cell_y = (int)y;
+    if (*cell_x < 0)
+        *cell_x = 0;
+    if (*cell_x >= actor_grid_width)
+        *cell_x = actor_grid_width - 1;
+    if (*cell_y < 0)
+        *cell_y = 0;
+    if (*cell_y >= actor_grid_height)
+        *cell_y = actor_grid_height - 1;
+}
+
+/* Which bucket a cell goes in. When they are hashed the rows get scattered around the
+ * buckets but the cells along a row stay next to each other, so the cells around an
+ * actor are still close together. */
+static int actor_bucket(int cell_x, int cell_y) {
+    if (actor_bucket_direct)
+        return cell_y * actor_grid_width + cell_x;
+    return (int)(((unsigned int)cell_y * 2654435761u + (unsigned int)cell_x) & actor_bucket_mask);
+}
+
+/* Sorts the actors into the buckets by counting how many land in each one first. Only
+ * the buckets that somebody is in get looked at, so it costs the same however big the
+ * map is. */
+static void actor_build_grid(void) {
+    const actor_state* state = &actor_states[actor_current];
+    int total = 0, i, k;
+
+    for (k = 0; k < actor_bucket_used_count; k++)
+        actor_buckets[actor_buckets_used[k]].count = 0;
+    actor_bucket_used_count = 0;
+    for (i = 0; i < actor_count; i++) {
+        int cell_x, cell_y, bucket;
+
+        actor_cell(state->x[i], state->y[i], &cell_x, &cell_y);
+        bucket = actor_bucket(cell_x, cell_y);
+        actor_cells[i] = bucket;
+        if (actor_buckets[bucket].count++ == 0)
+            actor_buckets_used[actor_bucket_used_count++] = bucket;
+    }
+    /* Each bucket starts out pointing at its end and the actors fill it from the back,
+     * which leaves it pointing at the first one in the bucket once they are all in. */
+    for (k = 0; k < actor_bucket_used_count; k++) {
+        actor_bucket_range* bucket = &actor_buckets[actor_buckets_used[k]];
+        total += bucket->count;
+        bucket->start = total;
+    }
+    for (i = actor_count - 1; i >= 0; i--) {
+        int cell_x, cell_y, slot;
+
+        slot = --actor_buckets[actor_cells[i]].start;
+        actor_cell(state->x[i], state->y[i], &cell_x, &cell_y);
+        actor_cell_items[slot] = i;
+        actor_cell_keys[slot] = cell_y * actor_grid_width + cell_x;
+    }
+    actor_grid_dirty = 0;
+}
+
+int actor_find(float x, float y, float radius, int* found, int max) {
+    const actor_state* state = &actor_states[actor_current];
+    int first_x = (int)floorf(x - radius), last_x = (int)floorf(x + radius);
+    int first_y = (int)floorf(y - radius), last_y = (int)floorf(y + radius);
+    int count = 0, cell_x, cell_y, k;
+
+    if (actor_count == 0)
+        return 0;
+    if (actor_grid_dirty)
+        actor_build_grid();
+    if (first_x < 0)
+        first_x = 0;
+    if (first_y < 0)
+        first_y = 0;
+    if (last_x >= actor_grid_width)
+        last_x = actor_grid_width - 1;
+    if (last_y >= actor_grid_height)
+        last_y = actor_grid_height - 1;
+
+    for (cell_y = first_y; cell_y <= last_y; cell_y++) {
+        for (cell_x = first_x; cell_x <= last_x; cell_x++) {
+            int cell = cell_y * actor_grid_width + cell_x;
+            const actor_bucket_range* bucket = &actor_buckets[actor_bucket(cell_x, cell_y)];
+
+            for (k = bucket->start; k < bucket->start + bucket->count; k++) {
+                int j = actor_cell_items[k];
+                float dx, dy;
+
+                /* Someone from another cell that landed in the same bucket. */
+                if (actor_cell_keys[k] != cell)
+                    continue;
+                dx = state->x[j] - x;
+                dy = state->y[j] - y;
+                if (dx * dx + dy * dy >= radius * radius)
+                    continue;
+                if (count == max)
+                    return count;
+                found[count++] = j;
+            }
+        }
+    }
+    return count;
+}
+
+/* Whether someone else is close by and somewhere in front of an actor. */
+static int actor_crowded(const actor_state* state, int i) {
+    int found[ACTOR_MAX_NEIGHBOURS];
+    int count = actor_find(state->x[i], state->y[i], ACTOR_SPACING, found, ACTOR_MAX_NEIGHBOURS);
+    int k;
+
+    for (k = 0; k < count; k++) {
+        int j = found[k];
+        float dx = state->x[j] - state->x[i];
+        float dy = state->y[j] - state->y[i];
+
+        if (j != i && dx * state->dir_x[i] + dy * state->dir_y[i] > 0.0f)
+            return 1;
+    }
+    return 0;
+}
+
+static void actor_update(void* data, int begin, int end) {
+    const actor_step* step = (const actor_step*)data;
+    const actor_state* from = &actor_states[actor_current];
+    actor_state* to = &actor_states[!actor_current];
+    int i;
+
+    PROF_BEGIN(update);
+    /* Every actor walks and turns the same way, so this part is the same maths over
+     * every element of the arrays with no branches and can be done a few at a time.
+     * Turning is either one way, the other or not at all, so the one sine and cosine
+     * for this tick covers all of them. */
+    for (i = begin; i < end; i++) {
+        float turn = from->turn[i];
+        float c = 1.0f + (step->turn_cos - 1.0f) * turn * turn;
+        float s = step->turn_sin * turn;
+        float walk = actor_speed[i] * step->delta_time;
+
+        to->x[i] = from->x[i] + from->dir_x[i] * walk;
+        to->y[i] = from->y[i] + from->dir_y[i] * walk;
+        to->dir_x[i] = from->dir_x[i] * c - from->dir_y[i] * s;
+        to->dir_y[i] = from->dir_x[i] * s + from->dir_y[i] * c;
+        to->plane_x[i] = from->plane_x[i] * c - from->plane_y[i] * s;
+        to->plane_y[i] = from->plane_x[i] * s + from->plane_y[i] * c;
+    }
+
+    /* Then the walls and everyone else get their say one actor at a time. Like the
+     * camera, a step gets taken back one side at a time if it would end up in a wall. */
+    for (i = begin; i < end; i++) {
+        int blocked = 0;
+
+        if (map_get((int)to->x[i], (int)from->y[i]) != 0) {
+            to->x[i] = from->x[i];
+            blocked = 1;
+        }
+        if (map_get((int)to->x[i], (int)to->y[i]) != 0) {
+            to->y[i] = from->y[i];
+            blocked = 1;
+        }
+        /* Keep turning while something is in the way and go straight otherwise. */
+        if (blocked || actor_crowded(from, i))
+            to->turn[i] = (i & 1) ? 1.0f : -1.0f;
+        else
+            to->turn[i] = 0.0f;
+    }
+    PROF_END(update, "actor update");
+}
+
+void actor_tick(float delta_time) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    actor_step step;
+    float* swap;
+
+    if (actor_count == 0)
+        return;
+    if (actor_grid_dirty)
+        actor_build_grid();
+
+    step.delta_time = delta_time;
+    step.turn_cos = cosf(ACTOR_TURN_SPEED * delta_time);
+    step.turn_sin = sinf(ACTOR_TURN_SPEED * delta_time);
+    pool_run(actor_pool, actor_update, &step, actor_count, ACTOR_CHUNK);
+    actor_current = !actor_current;
+    actor_build_grid();
+
+    /* Hand the new positions over to anyone drawing them. */
+    memcpy(actor_back_x, actor_states[actor_current].x, (size_t)actor_count * sizeof(float));
+    memcpy(actor_back_y, actor_states[actor_current].y, (size_t)actor_count * sizeof(float));
+    SDL_LockMutex(actor_lock);
+    swap = actor_front_x;
+    actor_front_x = actor_back_x;
+    actor_back_x = swap;
+    swap = actor_front_y;
+    actor_front_y = actor_back_y;
+    actor_back_y = swap;
+    SDL_UnlockMutex(actor_lock);
+
+    actor_tick_time = (float)(SDL_GetPerformanceCounter() - start) / (float)SDL_GetPerformanceFrequency();
+    PROF_END(start, "actor tick");
+}
+
+float actor_get_tick_time(void) {
+    return actor_tick_time;
+}
+
+int actor_copy_positions(float* x, float* y) {
+    if (actor_count == 0)
+        return 0;
+    SDL_LockMutex(actor_lock);
+    memcpy(x, actor_front_x, (size_t)actor_count * sizeof(float));
+    memcpy(y, actor_front_y, (size_t)actor_count * sizeof(float));
+    SDL_UnlockMutex(actor_lock);
+    return actor_count;
+}
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include "actor.h"
+#include "bench.h"
+#include "capture.h"
+#include "demo.h"
+#include "gfx.h"
+#include "map.h"
+#include "prof.h"
+#include "ray.h"
+
+#define BENCH_MAX_STEPS                 (256)
+
+/* One step of the input script, the keys are held down for a number of frames. */
+typedef struct {
+    int frames;
+    int keys[DEMO_INPUTS];
+} bench_step;
+
+/* The camera path that gets used when no script is given. It walks around the
+ * level looking at walls from near and far so both ends of the draw get used. */
+static const bench_step bench_default_script[] = {
+    { 60, { 1, 0, 0, 0 } },
+    { 30, { 0, 0, 1, 0 } },
+    { 45, { 1, 0, 0, 0 } },
+    { 60, { 0, 0, 0, 1 } },
+    { 90, { 1, 0, 1, 0 } },
+    { 40, { 0, 1, 0, 0 } },
+    { 75, { 1, 0, 0, 1 } },
+    { 50, { 0, 0, 0, 0 } }
+};
+
+static bench_step bench_script[BENCH_MAX_STEPS];
+static int bench_script_steps = 0;
+
+/* Read a script where every line is a frame count followed by the keys that are
+ * held, any of u, d, l, r and e for use or a - for none. For example "60 ul". */
+static int bench_load_script(const char* fname) {
+    FILE* file = fopen(fname, "r");
+    char keys[16];
+    int frames;
+
+    if (file == NULL)
+        return -1;
+
+    bench_script_steps = 0;
+    while (bench_script_steps < BENCH_MAX_STEPS && fscanf(file, "%d %15s", &frames, keys) == 2) {
+        bench_step* step;
+        if (frames <= 0)
+            continue;
+        step = &bench_script[bench_script_steps++];
+        step->frames = frames;
+        step->keys[DEMO_INPUT_UP] = strchr(keys, 'u') != NULL;
+        step->keys[DEMO_INPUT_DOWN] = strchr(keys, 'd') != NULL;
+        step->keys[DEMO_INPUT_LEFT] = strchr(keys, 'l') != NULL;
+        step->keys[DEMO_INPUT_RIGHT] = strchr(keys, 'r') != NULL;
+        step->keys[DEMO_INPUT_USE] = strchr(keys, 'e') != NULL;
+    }
+    fclose(file);
+    return bench_script_steps > 0 ? 0 : -1;
+}
+
+static int bench_compare(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void bench_sort(double* times, int count) {
+    qsort(times, count, sizeof(double), bench_compare);
+}
+
+/* Nearest rank percentile of a list sorted by bench_sort. */
+double bench_percentile(const double* sorted, int count, double percent) {
+    int rank = (int)(percent / 100.0 * count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+    return sorted[rank - 1];
+}
+
+/* A hash of the last frame so that a run can also be checked for drawing the
+ * same picture as before, not just for being as fast. */
+static unsigned int bench_checksum(void) {
+    int pitch, n;
+    const gfx_color* pixels = gfx_get_framebuffer(&pitch);
+    unsigned int hash = 2166136261u;
+
+    for (n = 0; n < pitch * demo_get_height(); n++) {
+        hash ^= pixels[n];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void bench_capture(void) {
+    int pitch;
+    const gfx_color* pixels = gfx_get_framebuffer(&pitch);
+
+    capture_frame(pixels, pitch, demo_get_width(), demo_get_height());
+}
+
+static void bench_free_views(demo_view* views, int count) {
+    int i;
+
+    for (i = 1; i < count; i++)
+        free(views[i].pixels);
+    free(views);
+}
+
+/* Everything but the first view draws into its own buffer the same size as the screen. */
+static demo_view* bench_create_views(int count) {
+    demo_view* views = (demo_view*)calloc((size_t)count, sizeof(demo_view));
+    int i;
+
+    if (views == NULL)
+        return NULL;
+    for (i = 0; i < count; i++) {
+        views[i].width = demo_get_width();
+        views[i].height = demo_get_height();
+        if (i == 0)
+            continue;
+        views[i].pitch = views[i].width;
+        views[i].pixels = (gfx_color*)malloc((size_t)views[i].pitch * views[i].height * sizeof(gfx_color));
+        if (views[i].pixels == NULL) {
+            bench_free_views(views, count);
+            return NULL;
+        }
+    }
+    return views;
+}
+
+/* Draws the demo camera into the framebuffer and every other view turned a bit further around. */
+static int bench_draw_views(demo_view* views, int count) {
+    ray_camera camera;
+    int i;
+
+    demo_get_camera(&camera);
+    gfx_set_size(demo_get_width(), demo_get_height());
+    views[0].pixels = gfx_get_framebuffer(&views[0].pitch);
+    for (i = 0; i < count; i++) {
+        float angle = 6.2831853f * (float)i / (float)count;
+        float c = cosf(angle), s = sinf(angle);
+
+        views[i].camera = camera;
+        if (i == 0)
+            continue;
+        views[i].camera.dir_x = camera.dir_x * c - camera.dir_y * s;
+        views[i].camera.dir_y = camera.dir_x * s + camera.dir_y * c;
+        views[i].camera.plane_x = camera.plane_x * c - camera.plane_y * s;
+        views[i].camera.plane_y = camera.plane_x * s + camera.plane_y * c;
+    }
+    return demo_draw_views(views, count);
+}
+
+int bench_run(const bench_config* config) {
+    static const char* isa_names[] = { "scalar", "sse2", "avx2" };
+    double* times;
+    double total = 0.0, freq;
+    double min_ms, mean_ms, p50_ms, p95_ms, p99_ms, max_ms, rays, pixels, views_per_second;
+    double actor_total = 0.0, actor_ms;
+    demo_view* views = NULL;
+    int view_count = config->views > 1 ? config->views : 1;
+    const bench_step* script = bench_default_script;
+    int steps = (int)(sizeof(bench_default_script) / sizeof(bench_default_script[0]));
+    int frame, step = 0, step_frame = 0;
+    unsigned int checksum;
+    int keys[DEMO_INPUTS];
+
+    if (config->frames <= 0)
+        return 1;
+    if (config->script != NULL) {
+        if (bench_load_script(config->script) != 0) {
+            fprintf(stderr, "Failed to read the benchmark script %s.\n", config->script);
+            return 1;
+        }
+        script = bench_script;
+        steps = bench_script_steps;
+    }
+
+    times = (double*)malloc(sizeof(double) * config->frames);
+    if (times == NULL)
+        return 1;
+    if (view_count > 1) {
+        views = bench_create_views(view_count);
+        if (views == NULL) {
+            fprintf(stderr, "Failed to make room for %d views.\n", view_count);
+            free(times);
+            return 1;
+        }
+    }
+    freq = (double)SDL_GetPerformanceFrequency();
+
+    for (frame = 0; frame < config->frames; frame++) {
+        Uint64 start, end;
+
+        /* Play the script back over and over until we have enough frames. */
+        while (step_frame >= script[step].frames) {
+            step = (step + 1) % steps;
+            step_frame = 0;
+        }
+        memcpy(keys, script[step].keys, sizeof(keys));
+        step_frame++;
+
+        /* Always use the same time step so every run sees exactly the same frames. */
+        start = SDL_GetPerformanceCounter();
+        demo_tick(BENCH_DELTA_TIME, keys);
+        /* Nothing else is ticking or drawing in between frames here, so any changes to
+         * the map that the tick queued can go straight in. */
+        map_apply_edits();
+        PROF_END(start, "demo_tick");
+        actor_total += actor_get_tick_time();
+        {
+            PROF_BEGIN(draw);
+            if (views != NULL)
+                bench_draw_views(views, view_count);
+            else
+                demo_draw();
+            gfx_present();
+            PROF_END(draw, "demo_draw");
+        }
+        end = SDL_GetPerformanceCounter();
+        /* Recording only costs a copy but it is left out of the frame time all the same. */
+        bench_capture();
+
+        times[frame] = (double)(end - start) / freq;
+        total += times[frame];
+    }
+    checksum = bench_checksum();
+    if (views != NULL)
+        bench_free_views(views, view_count);
+
+    bench_sort(times, config->frames);
+    min_ms = times[0] * 1000.0;
+    max_ms = times[config->frames - 1] * 1000.0;
+    mean_ms = total / config->frames * 1000.0;
+    p50_ms = bench_percentile(times, config->frames, 50.0) * 1000.0;
+    p95_ms = bench_percentile(times, config->frames, 95.0) * 1000.0;
+    p99_ms = bench_percentile(times, config->frames, 99.0) * 1000.0;
+    /* One ray goes out for every column of every view. */
+    rays = total > 0.0 ? (double)demo_get_width() * view_count * config->frames / total : 0.0;
+    pixels = total > 0.0 ? (double)demo_get_width() * demo_get_height() * view_count * config->frames / total : 0.0;
+    views_per_second = total > 0.0 ? (double)view_count * config->frames / total : 0.0;
+    /* The actors are part of the frame time above too, this is how much of it they took. */
+    actor_ms = actor_total / config->frames * 1000.0;
+    free(times);
+
+    /* The fixed point renderer does not use the vector kernels. */
+    printf("frames:     %d (%dx%d, %d views, %d workers, %s)\n", config->frames, demo_get_width(), demo_get_height(),
+        view_count, demo_get_workers(), demo_get_fixed_point() ? "fixed point" : isa_names[ray_get_isa()]);
+    printf("frame time: min %.3f ms, mean %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+        min_ms, mean_ms, p50_ms, p95_ms, p99_ms, max_ms);
+    printf("throughput: %.0f rays/s, %.0f pixels/s, %.1f views/s\n", rays, pixels, views_per_second);
+    if (actor_get_count() > 0)
+        printf("actors:     %d, %.3f ms per tick, %.3f ms per 10k\n", actor_get_count(), actor_ms,
+            actor_ms * 10000.0 / actor_get_count());
+    printf("checksum:   %08x\n", checksum);
+
+    if (config->json != NULL) {
+        FILE* file = fopen(config->json, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Failed to write the benchmark results to %s.\n", config->json);
+            return 1;
+        }
+        fprintf(file, "{\n");
+        fprintf(file, "  \"frames\": %d,\n", config->frames);
+        fprintf(file, "  \"width\": %d,\n", demo_get_width());
+        fprintf(file, "  \"height\": %d,\n", demo_get_height());
+        fprintf(file, "  \"views\": %d,\n", view_count);
+        fprintf(file, "  \"workers\": %d,\n", demo_get_workers());
+        fprintf(file, "  \"isa\": \"%s\",\n", isa_names[ray_get_isa()]);
+        fprintf(file, "  \"fixed_point\": %s,\n", demo_get_fixed_point() ? "true" : "false");
+        fprintf(file, "  \"delta_time\": %.9f,\n", BENCH_DELTA_TIME);
+        fprintf(file, "  \"frame_ms\": {\n");
+        fprintf(file, "    \"min\": %.6f,\n", min_ms);
+        fprintf(file, "    \"mean\": %.6f,\n", mean_ms);
+        fprintf(file, "    \"p50\": %.6f,\n", p50_ms);
+        fprintf(file, "    \"p95\": %.6f,\n", p95_ms);
+        fprintf(file, "    \"p99\": %.6f,\n", p99_ms);
+        fprintf(file, "    \"max\": %.6f\n", max_ms);
+        fprintf(file, "  },\n");
+        fprintf(file, "  \"rays_per_second\": %.1f,\n", rays);
+        fprintf(file, "  \"pixels_per_second\": %.1f,\n", pixels);
+        fprintf(file, "  \"views_per_second\": %.1f,\n", views_per_second);
+        fprintf(file, "  \"actors\": %d,\n", actor_get_count());
+        fprintf(file, "  \"actor_tick_ms\": %.6f,\n", actor_ms);
+        fprintf(file, "  \"checksum\": \"%08x\"\n", checksum);
+        fprintf(file, "}\n");
+        fclose(file);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "capture.h"
+#include "prof.h"
+
+/* A frame waiting for the writer, kept at the size that it was drawn at. */
+typedef struct {
+    gfx_color* pixels;
+    int width, height;
+    /* When the frame was handed over in microseconds of the performance counter, the
+     * same clock that the timing zones use, and how many were dropped before it. */
+    double time;
+    int dropped;
+} capture_buffer;
+
+/* The buffers get filled and written in the same order so they go around in a ring.
+ * One semaphore counts the buffers that are free to fill and the other the ones that
+ * are ready to write, so the two sides never have to lock anything else. */
+static capture_buffer capture_buffers[CAPTURE_BUFFERS];
+static SDL_sem* capture_free = NULL;
+static SDL_sem* capture_full = NULL;
+static SDL_Thread* capture_thread = NULL;
+static int capture_fill_next = 0;
+static int capture_write_next = 0;
+static SDL_atomic_t capture_submitted;
+
+static FILE* capture_file = NULL;
+/* Frames are written as Y4M if the file name asks for it, otherwise as one PPM after another. */
+static int capture_y4m = 0;
+static int capture_width = 0, capture_height = 0;
+/* The frame converted to what goes in the file and the source column for each column of it. */
+static unsigned char* capture_output = NULL;
+static size_t capture_output_size = 0;
+static int* capture_columns = NULL;
+
+/* Only the thread handing over the frames counts the ones that get dropped. */
+static int capture_dropped = 0;
+static SDL_atomic_t capture_written;
+static SDL_atomic_t capture_failed;
+
+/* Full range BT.601, the same as JPEG uses, so black and white stay at 0 and 255.
+ * The chroma sums four pixels at once. */
+#define CAPTURE_Y(r, g, b)              ((77 * (r) + 150 * (g) + 29 * (b) + 128) >> 8)
+#define CAPTURE_CB(r, g, b)             ((-43 * (r) - 85 * (g) + 128 * (b) + 4 * 32896) >> 10)
+#define CAPTURE_CR(r, g, b)             ((128 * (r) - 107 * (g) - 21 * (b) + 4 * 32896) >> 10)
+#define CAPTURE_CLAMP(value)            ((unsigned char)((value) > 255 ? 255 : (value)))
+
+/* The frames can be drawn smaller than the capture when the resolution drops. They
+ * get stretched back up the same way the window does so the video keeps one size. */
+static const gfx_color* capture_row(const capture_buffer* buffer, int y) {
+    if (y >= capture_height)
+        y = capture_height - 1;
+    return buffer->pixels + (y * buffer->height / capture_height) * buffer->width;
+}
+
+static size_t capture_convert_y4m(const capture_buffer* buffer) {
+    unsigned char* out = capture_output;
+    int chroma_width = (capture_width + 1) / 2;
+    int chroma_height = (capture_height + 1) / 2;
+    unsigned char* cb;
+    unsigned char* cr;
+    int x, y;
+
+    out += sprintf((char*)out, "FRAME Xtime_us=%.3f Xdropped=%d\n", buffer->time, buffer->dropped);
+    cb = out + (size_t)capture_width * capture_height;
+    cr = cb + (size_t)chroma_width * chroma_height;
+
+    for (y = 0; y < capture_height; y++) {
+        const gfx_color* row = capture_row(buffer, y);
+        for (x = 0; x < capture_width; x++) {
+            gfx_color color = row[capture_columns[x]];
+            *out++ = (unsigned char)CAPTURE_Y((color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+        }
+    }
+
+    /* Every chroma sample covers a block of two by two pixels. */
+    for (y = 0; y < chroma_height; y++) {
+        const gfx_color* top = capture_row(buffer, y * 2);
+        const gfx_color* bottom = capture_row(buffer, y * 2 + 1);
+        for (x = 0; x < chroma_width; x++) {
+            int left = capture_columns[x * 2];
+            int right = capture_columns[x * 2 + 1 < capture_width ? x * 2 + 1 : x * 2];
+            gfx_color a = top[left], b = top[right], c = bottom[left], d = bottom[right];
+            int r = (int)(((a >> 16) & 0xFF) + ((b >> 16) & 0xFF) + ((c >> 16) & 0xFF) + ((d >> 16) & 0xFF));
+            int g = (int)(((a >> 8) & 0xFF) + ((b >> 8) & 0xFF) + ((c >> 8) & 0xFF) + ((d >> 8) & 0xFF));
+            int bl = (int)((a & 0xFF) + (b & 0xFF) + (c & 0xFF) + (d & 0xFF));
+            *cb++ = CAPTURE_CLAMP(CAPTURE_CB(r, g, bl));
+            *cr++ = CAPTURE_CLAMP(CAPTURE_CR(r, g, bl));
+        }
+    }
+    return (size_t)(cr - capture_output);
+}
+
+static size_t capture_convert_ppm(const capture_buffer* buffer) {
+    unsigned char* out = capture_output;
+    int x, y;
+
+    out += sprintf((char*)out, "P6\n# time_us %.3f dropped %d\n%d %d\n255\n", buffer->time, buffer->dropped,
+        capture_width, capture_height);
+    for (y = 0; y < capture_height; y++) {
+        const gfx_color* row = capture_row(buffer, y);
+        for (x = 0; x < capture_width; x++) {
+            gfx_color color = row[capture_columns[x]];
+            *out++ = (unsigned char)((color >> 16) & 0xFF);
+            *out++ = (unsigned char)((color >> 8) & 0xFF);
+            *out++ = (unsigned char)(color & 0xFF);
+        }
+    }
+    return (size_t)(out - capture_output);
+}
+
+static int capture_run(void* data) {
+    (void)data;
+    PROF_THREAD("capture");
+
+    for (;;) {
+        capture_buffer* buffer;
+        size_t size;
+        int x;
+
+        /* Being woken up with nothing left to write means it is time to stop. */
+        SDL_SemWait(capture_full);
+        if (capture_write_next == SDL_AtomicGet(&capture_submitted))
+            break;
+        buffer = &capture_buffers[capture_write_next % CAPTURE_BUFFERS];
+
+        /* Once the disk has failed the frames just get thrown away so that the
+         * renderer never ends up waiting on us. */
+        if (!SDL_AtomicGet(&capture_failed)) {
+            PROF_BEGIN(write);
+            for (x = 0; x < capture_width; x++)
+                capture_columns[x] = x * buffer->width / capture_width;
+            size = capture_y4m ? capture_convert_y4m(buffer) : capture_convert_ppm(buffer);
+            if (fwrite(capture_output, 1, size, capture_file) != size)
+                SDL_AtomicSet(&capture_failed, 1);
+            else
+                SDL_AtomicAdd(&capture_written, 1);
+            PROF_END(write, "capture write");
+        }
+
+        capture_write_next++;
+        SDL_SemPost(capture_free);
+    }
+    return 0;
+}
+
+int capture_start(const char* fname, int width, int height, int rate) {
+    size_t length = strlen(fname);
+    int i;
+
+    capture_y4m = length >= 4 && SDL_strcasecmp(fname + length - 4, ".y4m") == 0;
+    capture_width = width;
+    capture_height = height;
+    capture_fill_next = 0;
+    capture_write_next = 0;
+    capture_dropped = 0;
+    SDL_AtomicSet(&capture_submitted, 0);
+    SDL_AtomicSet(&capture_written, 0);
+    SDL_AtomicSet(&capture_failed, 0);
+
+    /* Room for the biggest frame header as well as the pixels. */
+    capture_output_size = (size_t)width * height * 3 + 256;
+    capture_output = (unsigned char*)malloc(capture_output_size);
+    capture_columns = (int*)malloc((size_t)width * sizeof(int));
+    if (capture_output == NULL || capture_columns == NULL) {
+        capture_stop();
+        return -1;
+    }
+    for (i = 0; i < CAPTURE_BUFFERS; i++) {
+        capture_buffers[i].pixels = (gfx_color*)malloc((size_t)width * height * sizeof(gfx_color));
+        if (capture_buffers[i].pixels == NULL) {
+            capture_stop();
+            return -1;
+        }
+    }
+
+    capture_file = fopen(fname, "wb");
+    if (capture_file == NULL) {
+        capture_stop();
+        return -1;
+    }
+    /* Everything goes to the disk in big sequential writes instead of one per frame. */
+    setvbuf(capture_file, NULL, _IOFBF, CAPTURE_WRITE_SIZE);
+    if (capture_y4m)
+        fprintf(capture_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, rate);
+
+    capture_free = SDL_CreateSemaphore(CAPTURE_BUFFERS);
+    capture_full = SDL_CreateSemaphore(0);
+    if (capture_free == NULL || capture_full == NULL) {
+        capture_stop();
+        return -1;
+    }
+    capture_thread = SDL_CreateThread(capture_run, "capture", NULL);
+    if (capture_thread == NULL) {
+        capture_stop();
+        return -1;
+    }
+    return 0;
+}
+
+int capture_stop(void) {
+    int result = 0, i;
+
+    /* Everything that was already handed over still gets written out first. */
+    if (capture_thread != NULL) {
+        SDL_SemPost(capture_full);
+        SDL_WaitThread(capture_thread, NULL);
+        capture_thread = NULL;
+    }
+    if (capture_full != NULL)
+        SDL_DestroySemaphore(capture_full);
+    if (capture_free != NULL)
+        SDL_DestroySemaphore(capture_free);
+    capture_full = NULL;
+    capture_free = NULL;
+
+    if (capture_file != NULL) {
+        if (fclose(capture_file) != 0)
+            SDL_AtomicSet(&capture_failed, 1);
+        capture_file = NULL;
+    }
+    if (SDL_AtomicGet(&capture_failed))
+        result = -1;
+
+    for (i = 0; i < CAPTURE_BUFFERS; i++) {
+        free(capture_buffers[i].pixels);
+        capture_buffers[i].pixels = NULL;
+    }
+    free(capture_output);
+    free(capture_columns);
+    capture_output = NULL;
+    capture_columns = NULL;
+    return result;
+}
+
+void capture_frame(const gfx_color* pixels, int pitch, int width, int height) {
+    capture_buffer* buffer;
+    int y;
+
+    if (capture_thread == NULL)
+        return;
+    if (width > capture_width)
+        width = capture_width;
+    if (height > capture_height)
+        height = capture_height;
+
+    /* If the writer has not caught up then this frame is lost rather than the
+     * renderer being held up. The next frame that makes it says how many went. */
+    if (SDL_SemTryWait(capture_free) != 0) {
+        capture_dropped++;
+        return;
+    }
+
+    PROF_BEGIN(copy);
+    buffer = &capture_buffers[capture_fill_next % CAPTURE_BUFFERS];
+    for (y = 0; y < height; y++)
+        memcpy(buffer->pixels + y * width, pixels + y * pitch, (size_t)width * sizeof(gfx_color));
+    buffer->width = width;
+    buffer->height = height;
+    buffer->time = (double)SDL_GetPerformanceCounter() * 1000000.0 / (double)SDL_GetPerformanceFrequency();
+    buffer->dropped = capture_dropped;
+    capture_fill_next++;
+    SDL_AtomicSet(&capture_submitted, capture_fill_next);
+    SDL_SemPost(capture_full);
+    PROF_END(copy, "capture copy");
+}
+
+int capture_get_written(void) {
+    return SDL_AtomicGet(&capture_written);
+}
+
+int capture_get_dropped(void) {
+    return capture_dropped;
+}
\ No newline at end of file
@@ -0,0 +1,476 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include "check.h"
+#include "fixed.h"
+#include "gfx.h"
+#include "map.h"
+#include "ray.h"
+#include "shade.h"
+#include "sprite.h"
+
+#define CHECK_MAP_SIZE                  (64)
+#define CHECK_CAMERAS                   (2000)
+#define CHECK_WIDTH                     (320)
+#define CHECK_HEIGHT                    (240)
+/* One camera in this many faces straight along an axis, so the column in the middle
+ * of the screen has a ray with a direction of exactly zero across it. */
+#define CHECK_AXIS_EVERY                (8)
+/* How far off the wall an axis ray is allowed to be. The float ones land exactly on it. */
+#define CHECK_AXIS_ERROR                (0.001f)
+/* The fixed point rays can not match the float ones exactly. They may be this far
+ * off in distance, and only this many of the columns can be further off than that
+ * or hit a different block altogether. */
+#define CHECK_FIXED_ERROR               (0.02f)
+#define CHECK_FIXED_MISSES              (0.001)
+/* How many cells get changed one at a time, and how many of those changes put a wall in. */
+#define CHECK_EDITS                     (500)
+#define CHECK_EDIT_SOLID                (0.2f)
+/* How many times the queue of changes gets filled up and applied. */
+#define CHECK_EDIT_BATCHES              (20)
+#define CHECK_MAP                       ("check.map")
+/* Sprites go from just in front of the camera to this far away so that every byte of
+ * their depths gets sorted on. The screen is tall enough that even the furthest ones
+ * are still a couple of pixels high. */
+#define CHECK_SPRITES                   (5000)
+#define CHECK_SPRITE_FAR                (2000.0f)
+#define CHECK_SPRITE_WIDTH              (64)
+#define CHECK_SPRITE_HEIGHT             (4096)
+#define CHECK_BUNDLE                    ("check.bundle")
+
+/* The checks make up their own maps and cameras from a seed so every run sees the same ones. */
+static unsigned int check_seed = 1;
+
+static float check_random(void) {
+    check_seed = check_seed * 1664525u + 1013904223u;
+    return (float)(check_seed >> 8) / 16777216.0f;
+}
+
+static void check_report(const char* name, int failures, const char* what) {
+    if (failures == 0)
+        printf("%-11s ok\n", name);
+    else
+        printf("%-11s FAILED, %d %s\n", name, failures, what);
+}
+
+/* Somewhere empty on the map looking any which way, or straight along an axis. */
+static void check_camera(ray_camera* camera, int axis) {
+    static const float axis_dirs[4][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f }, { -1.0f, 0.0f }, { 0.0f, -1.0f } };
+    float angle;
+    int x, y;
+
+    do {
+        x = 1 + (int)(check_random() * (CHECK_MAP_SIZE - 2));
+        y = 1 + (int)(check_random() * (CHECK_MAP_SIZE - 2));
+    } while (map_get(x, y) != 0);
+    camera->x = (float)x + check_random() * 0.999f;
+    camera->y = (float)y + check_random() * 0.999f;
+    if (axis) {
+        int dir = (int)(check_random() * 4.0f);
+        camera->dir_x = axis_dirs[dir][0];
+        camera->dir_y = axis_dirs[dir][1];
+    } else {
+        angle = check_random() * 6.2831853f;
+        camera->dir_x = cosf(angle);
+        camera->dir_y = sinf(angle);
+    }
+    camera->plane_x = -camera->dir_y * 0.66f;
+    camera->plane_y = camera->dir_x * 0.66f;
+}
+
+/* Only the float fields, the fixed point ones are left alone by the float kernels. */
+static int check_same_hits(const ray_hit* a, const ray_hit* b, int count) {
+    int x, different = 0;
+
+    for (x = 0; x < count; x++) {
+        if (memcmp(&a[x], &b[x], offsetof(ray_hit, fixed_perp_wall_dist)) != 0)
+            different++;
+    }
+    return different;
+}
+
+/* The vector kernels have to hit exactly the same walls as the scalar one, and so
+ * does the scalar one when it skips over empty space with the distance field. */
+static int check_rays(void) {
+    static const char* isa_names[] = { "scalar", "sse2", "avx2" };
+    static ray_hit expected[CHECK_WIDTH];
+    static ray_hit hits[CHECK_WIDTH];
+    map_data no_distance;
+    int failures[RAY_ISA_AVX2 + 1] = { 0 };
+    int i, isa, result = 0;
+
+    if (map_generate(CHECK_MAP_SIZE, CHECK_MAP_SIZE, 1) != 0) {
+        check_report("rays", 1, "maps that could not be made");
+        return 1;
+    }
+    no_distance = *map_get_data();
+    no_distance.distance = NULL;
+    ray_set_max_distance(RAY_MAX_DISTANCE);
+
+    for (i = 0; i < CHECK_CAMERAS; i++) {
+        ray_camera camera;
+
+        check_camera(&camera, i % CHECK_AXIS_EVERY == 0);
+        /* What every kernel gets held to is the scalar one visiting every block. */
+        ray_select_isa(RAY_ISA_SCALAR);
+        ray_set_map(&no_distance);
+        ray_cast(&camera, CHECK_WIDTH, CHECK_HEIGHT, 0, CHECK_WIDTH, expected);
+        ray_set_map(map_get_data());
+
+        for (isa = RAY_ISA_SCALAR; isa <= RAY_ISA_AVX2; isa++) {
+            /* Anything this processor can not do is left out. */
+            if (ray_select_isa(isa) != isa)
+                continue;
+            ray_cast(&camera, CHECK_WIDTH, CHECK_HEIGHT, 0, CHECK_WIDTH, hits);
+            failures[isa] += check_same_hits(expected, hits, CHECK_WIDTH);
+        }
+    }
+
+    ray_select_isa(RAY_ISA_AUTO);
+    for (isa = RAY_ISA_SCALAR; isa <= RAY_ISA_AVX2; isa++) {
+        char name[32];
+        sprintf(name, "rays %s", isa_names[isa]);
+        if (ray_get_isa() >= isa)
+            check_report(name, failures[isa], "columns that differ from the plain scalar walk");
+        result |= failures[isa] != 0;
+    }
+    map_free();
+    return result;
+}
+
+/* A ray straight along an axis has to stop at the first wall in that direction, right
+ * on its face. Returns 1 if it did not. */
+static int check_axis_hit(const ray_camera* camera, const ray_hit* hit) {
+    int step_x = camera->dir_x > 0.0f ? 1 : camera->dir_x < 0.0f ? -1 : 0;
+    int step_y = camera->dir_y > 0.0f ? 1 : camera->dir_y < 0.0f ? -1 : 0;
+    int x = (int)camera->x, y = (int)camera->y;
+    float distance;
+
+    do {
+        x += step_x;
+        y += step_y;
+    } while (map_get(x, y) == 0);
+    if (step_x != 0)
+        distance = step_x > 0 ? (float)x - camera->x : camera->x - (float)(x + 1);
+    else
+        distance = step_y > 0 ? (float)y - camera->y : camera->y - (float)(y + 1);
+
+    return hit->cell != map_get(x, y) || hit->map_x != x || hit->map_y != y || hit->side != (step_x != 0 ? 0 : 1) ||
+        fabsf(hit->perp_wall_dist - distance) > CHECK_AXIS_ERROR;
+}
+
+/* Rays that run exactly along one axis never cross a side in the other direction.
+ * Every kernel, the fixed point one included, has to cope with that. */
+static int check_axis(void) {
+    static ray_hit hits[CHECK_WIDTH];
+    int failures = 0;
+    int i, isa;
+
+    if (map_generate(CHECK_MAP_SIZE, CHECK_MAP_SIZE, 3) != 0) {
+        check_report("axis", 1, "maps that could not be made");
+        return 1;
+    }
+    ray_set_map(map_get_data());
+    ray_set_max_distance(RAY_MAX_DISTANCE);
+    fixed_init();
+
+    for (i = 0; i < CHECK_CAMERAS / CHECK_AXIS_EVERY; i++) {
+        ray_camera camera;
+
+        check_camera(&camera, 1);
+        for (isa = RAY_ISA_SCALAR; isa <= RAY_ISA_AVX2; isa++) {
+            if (ray_select_isa(isa) != isa)
+                continue;
+            ray_cast(&camera, CHECK_WIDTH, CHECK_HEIGHT, 0, CHECK_WIDTH, hits);
+            failures += check_axis_hit(&camera, &hits[CHECK_WIDTH / 2]);
+        }
+        ray_cast_fixed(&camera, CHECK_WIDTH, CHECK_HEIGHT, 0, CHECK_WIDTH, hits);
+        failures += check_axis_hit(&camera, &hits[CHECK_WIDTH / 2]);
+    }
+
+    ray_select_isa(RAY_ISA_AUTO);
+    map_free();
+    check_report("axis", failures, "rays straight along an axis that missed the first wall");
+    return failures != 0;
+}
+
+/* The fixed point rays round differently so they only have to come close to the
+ * float ones, but they have to do that for nearly every column. */
+static int check_fixed(void) {
+    static ray_hit expected[CHECK_WIDTH];
+    static ray_hit hits[CHECK_WIDTH];
+    int columns = 0, misses = 0;
+    int i, x;
+
+    if (map_generate(CHECK_MAP_SIZE, CHECK_MAP_SIZE, 4) != 0) {
+        check_report("fixed", 1, "maps that could not be made");
+        return 1;
+    }
+    ray_set_map(map_get_data());
+    ray_set_max_distance(RAY_MAX_DISTANCE);
+    ray_select_isa(RAY_ISA_SCALAR);
+    fixed_init();
+
+    for (i = 0; i < CHECK_CAMERAS; i++) {
+        ray_camera camera;
+
+        check_camera(&camera, i % CHECK_AXIS_EVERY == 0);
+        ray_cast(&camera, CHECK_WIDTH, CHECK_HEIGHT, 0, CHECK_WIDTH, expected);
+        ray_cast_fixed(&camera, CHECK_WIDTH, CHECK_HEIGHT, 0, CHECK_WIDTH, hits);
+        for (x = 0; x < CHECK_WIDTH; x++) {
+            columns++;
+            if (hits[x].cell != expected[x].cell || hits[x].map_x != expected[x].map_x ||
+                hits[x].map_y != expected[x].map_y || hits[x].side != expected[x].side)
+                misses++;
+            else if (expected[x].cell != 0 &&
+                fabsf(hits[x].perp_wall_dist - expected[x].perp_wall_dist) > CHECK_FIXED_ERROR * expected[x].perp_wall_dist)
+                misses++;
+        }
+    }
+
+    ray_select_isa(RAY_ISA_AUTO);
+    map_free();
+    if (misses > columns * CHECK_FIXED_MISSES) {
+        check_report("fixed", misses, "columns too far from the float rays");
+        return 1;
+    }
+    printf("%-11s ok, %d of %d columns off\n", "fixed", misses, columns);
+    return 0;
+}
+
+/* Changing a cell only redoes the distance field around it, which has to come out
+ * the same as building the whole thing again. It starts out empty so that the first
+ * few walls change the distances a long way from where they went in. */
+static int check_distance(void) {
+    const map_data* map;
+    unsigned char* updated;
+    size_t size, n;
+    int i, failures = 0;
+
+    if (map_create(CHECK_MAP_SIZE, CHECK_MAP_SIZE) != 0 || map_build_distance() != 0) {
+        map_free();
+        check_report("distance", 1, "maps that could not be made");
+        return 1;
+    }
+    map = map_get_data();
+    size = (size_t)map->tiles_x * map->tiles_y * MAP_TILE_SIZE * MAP_TILE_SIZE;
+    updated = (unsigned char*)malloc(size);
+    if (updated == NULL) {
+        map_free();
+        return 1;
+    }
+
+    for (i = 0; i < CHECK_EDITS; i++) {
+        int x = (int)(check_random() * CHECK_MAP_SIZE);
+        int y = (int)(check_random() * CHECK_MAP_SIZE);
+        int different = 0;
+
+        map_set(x, y, check_random() < CHECK_EDIT_SOLID ? 1 : 0);
+        memcpy(updated, map->distance, size);
+        map_build_distance();
+        for (n = 0; n < size; n++)
+            different |= updated[n] != map->distance[n];
+        failures += different;
+    }
+    free(updated);
+    map_free();
+
+    check_report("distance", failures, "changes that left the distance field different from a full rebuild");
+    return failures != 0;
+}
+
+/* Changes that get queued up and applied between frames have to come out the same as
+ * making them straight away in the order they were queued, on a map that came from a
+ * file. A full queue has to turn anything more away instead of losing what is in it. */
+static int check_edits(void) {
+    static unsigned char expected[CHECK_MAP_SIZE * CHECK_MAP_SIZE];
+    const map_data* map;
+    unsigned char* updated;
+    size_t size, n;
+    int i, x, y, failures = 0;
+
+    if (map_generate(CHECK_MAP_SIZE, CHECK_MAP_SIZE, 5) != 0 || map_save(CHECK_MAP) != 0 || map_load(CHECK_MAP) != 0) {
+        map_free();
+        remove(CHECK_MAP);
+        check_report("edits", 1, "maps that could not be saved and loaded");
+        return 1;
+    }
+    /* The map is all in memory once it is loaded, so the file can go straight away. */
+    remove(CHECK_MAP);
+    map = map_get_data();
+    size = (size_t)map->tiles_x * map->tiles_y * MAP_TILE_SIZE * MAP_TILE_SIZE;
+    updated = (unsigned char*)malloc(size);
+    if (updated == NULL) {
+        map_free();
+        return 1;
+    }
+    for (y = 0; y < CHECK_MAP_SIZE; y++) {
+        for (x = 0; x < CHECK_MAP_SIZE; x++)
+            expected[y * CHECK_MAP_SIZE + x] = (unsigned char)map_get(x, y);
+    }
+
+    for (i = 0; i < CHECK_EDIT_BATCHES; i++) {
+        int count = i % 2 == 0 ? MAP_MAX_EDITS : 1 + (int)(check_random() * (MAP_MAX_EDITS - 1));
+        int different = 0;
+
+        for (n = 0; n < (size_t)count; n++) {
+            int value = check_random() < CHECK_EDIT_SOLID ? 1 : 0;
+            x = (int)(check_random() * CHECK_MAP_SIZE);
+            y = (int)(check_random() * CHECK_MAP_SIZE);
+            if (map_queue_set(x, y, value) != 0)
+                different = 1;
+            expected[y * CHECK_MAP_SIZE + x] = (unsigned char)value;
+        }
+        if (count == MAP_MAX_EDITS && map_queue_set(0, 0, 1) == 0)
+            different = 1;
+        map_apply_edits();
+
+        for (y = 0; y < CHECK_MAP_SIZE; y++) {
+            for (x = 0; x < CHECK_MAP_SIZE; x++)
+                different |= map_get(x, y) != expected[y * CHECK_MAP_SIZE + x];
+        }
+        memcpy(updated, map->distance, size);
+        map_build_distance();
+        for (n = 0; n < size; n++)
+            different |= updated[n] != map->distance[n];
+        failures += different;
+    }
+    free(updated);
+    map_free();
+
+    check_report("edits", failures, "batches of queued changes that did not come out the same");
+    return failures != 0;
+}
+
+/* A hash of everything about a bitmap that the drawing code reads. */
+static unsigned int check_bitmap_hash(int index) {
+    unsigned int hash = 2166136261u;
+    int level, n, pitch;
+    const gfx_color* texels = gfx_get_bitmap_pixels(index, &pitch);
+    int width = gfx_get_bitmap_width(index);
+    int height = gfx_get_bitmap_height(index);
+
+    hash = (hash ^ (unsigned int)width) * 16777619u;
+    hash = (hash ^ (unsigned int)height) * 16777619u;
+    hash = (hash ^ (unsigned int)gfx_get_bitmap_masked(index)) * 16777619u;
+    for (n = 0; n < width * height; n++)
+        hash = (hash ^ texels[(n / width) * pitch + n % width]) * 16777619u;
+    for (level = 0; level < gfx_get_bitmap_levels(index); level++) {
+        const gfx_color* mip = gfx_get_bitmap_mip(index, level);
+        for (n = 0; n < GFX_MIP_SIZE(width, level) * GFX_MIP_SIZE(height, level); n++)
+            hash = (hash ^ mip[n]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Bitmaps that go into a bundle have to come back out of it just the same. */
+static int check_bundle(void) {
+    static const char* files[] = { "steel.bmp", "bricks.bmp" };
+    unsigned int hashes[sizeof(files) / sizeof(files[0])];
+    int count = (int)(sizeof(files) / sizeof(files[0]));
+    int i, index, failures = 0;
+
+    for (i = 0; i < count; i++) {
+        index = gfx_generate_bitmap(files[i]);
+        if (index < 0) {
+            gfx_free();
+            check_report("bundle", 1, "bitmaps that could not be loaded");
+            return 1;
+        }
+        hashes[i] = check_bitmap_hash(index);
+    }
+    if (gfx_save_bundle(CHECK_BUNDLE) != 0) {
+        gfx_free();
+        check_report("bundle", 1, "bundles that could not be written");
+        return 1;
+    }
+    gfx_free();
+
+    if (gfx_load_bundle(CHECK_BUNDLE) < 0) {
+        failures = count;
+    } else {
+        for (i = 0; i < count; i++) {
+            index = gfx_find_bitmap(files[i]);
+            if (index < 0 || check_bitmap_hash(index) != hashes[i])
+                failures++;
+        }
+        if (gfx_get_bitmap_count() != count)
+            failures++;
+    }
+    /* The bundle stays mapped until the bitmaps are gone. */
+    gfx_free();
+    remove(CHECK_BUNDLE);
+
+    check_report("bundle", failures, "bitmaps that did not come back the same");
+    return failures != 0;
+}
+
+/* The sprites have to come out of culling furthest first, and ones at the same depth
+ * have to stay in the order they went in so that they never flicker. */
+static int check_sort(void) {
+    static float depth[CHECK_SPRITE_WIDTH];
+    ray_camera camera = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.66f };
+    sprite_view view;
+    char* seen;
+    float ahead = 0.0f;
+    int i, failures = 0;
+
+    if (sprite_init(CHECK_SPRITES) != 0 || sprite_view_init(&view) != 0) {
+        sprite_free();
+        return 1;
+    }
+    seen = (char*)calloc(CHECK_SPRITES, 1);
+    if (seen == NULL) {
+        sprite_view_free(&view);
+        sprite_free();
+        return 1;
+    }
+
+    /* Every sprite is in front of the camera and on the screen, with some of them
+     * sharing a depth with the one before. */
+    for (i = 0; i < CHECK_SPRITES; i++) {
+        float across;
+        if (i == 0 || check_random() >= 0.1f)
+            ahead = SPRITE_NEAR * 2.0f + check_random() * CHECK_SPRITE_FAR;
+        across = (check_random() - 0.5f) * ahead;
+        sprite_add(ahead, across * camera.plane_y, 0);
+    }
+    for (i = 0; i < CHECK_SPRITE_WIDTH; i++)
+        depth[i] = CHECK_SPRITE_FAR * 2.0f;
+    shade_set_max_light(CHECK_SPRITE_FAR * 2.0f);
+
+    if (sprite_cull(&view, &camera, depth, CHECK_SPRITE_WIDTH, CHECK_SPRITE_HEIGHT) != CHECK_SPRITES)
+        failures++;
+    for (i = 0; i < view.count; i++) {
+        int sprite = view.visible[i];
+        if (seen[sprite]++)
+            failures++;
+        if (i == 0)
+            continue;
+        if (view.ahead[view.visible[i - 1]] < view.ahead[sprite])
+            failures++;
+        else if (view.ahead[view.visible[i - 1]] == view.ahead[sprite] && view.visible[i - 1] < sprite)
+            failures++;
+    }
+
+    free(seen);
+    sprite_view_free(&view);
+    sprite_free();
+    check_report("sort", failures, "sprites out of order");
+    return failures != 0;
+}
+
+int check_run(void) {
+    int result = 0;
+
+    result |= check_rays();
+    result |= check_axis();
+    result |= check_fixed();
+    result |= check_distance();
+    result |= check_edits();
+    result |= check_bundle();
+    result |= check_sort();
+    return result;
+}
\ No newline at end of file
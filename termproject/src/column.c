@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include "column.h"
+
+/* Every kernel gets written out once for each size that a bitmap column can be so
+ * that the wrap around mask is a constant, once for whether the bitmap has see through
+ * parts and once for how it is lit. The loops that come out of that have nothing
+ * left in them to decide, they just read a texel and write a pixel. */
+#define COLUMN_PARAMS                   gfx_color* pixel, int pitch, int count, const gfx_color* texels, float current, float step, const unsigned char* shade
+#define COLUMN_TEXEL(shift)             texels[(int)current & ((1 << (shift)) - 1)]
+/* The fixed point ones are the same loops stepping with whole numbers. Being unsigned
+ * they can wrap around as far as they like, the mask only keeps the bits below. */
+#define COLUMN_FIXED_PARAMS             gfx_color* pixel, int pitch, int count, const gfx_color* texels, unsigned int current, unsigned int step, const unsigned char* shade
+#define COLUMN_FIXED_TEXEL(shift)       texels[(current >> FIXED_SHIFT) & ((1 << (shift)) - 1)]
+/* The top bit of the alpha is all that decides whether a texel gets drawn. This turns
+ * it into a mask of all ones or all zeros to pick between the texel and the pixel. */
+#define COLUMN_MASK(texel)              ((gfx_color)0 - ((texel) >> 31))
+
+#define COLUMN_KERNEL_SET(name, shift, params, sample) \
+    static void column_opaque_dark_##name(params) { \
+        (void)texels; (void)current; (void)step; (void)shade; \
+        for (; count > 0; count--, pixel += pitch) \
+            *pixel = GFX_RGB(0, 0, 0); \
+    } \
+    static void column_opaque_shaded_##name(params) { \
+        for (; count > 0; count--, pixel += pitch) { \
+            gfx_color texel = sample(shift); \
+            *pixel = SHADE_COLOR(shade, texel); \
+            current += step; \
+        } \
+    } \
+    static void column_opaque_full_##name(params) { \
+        (void)shade; \
+        for (; count > 0; count--, pixel += pitch) { \
+            *pixel = sample(shift) | GFX_RGB(0, 0, 0); \
+            current += step; \
+        } \
+    } \
+    static void column_masked_dark_##name(params) { \
+        (void)shade; \
+        for (; count > 0; count--, pixel += pitch) { \
+            gfx_color mask = COLUMN_MASK(sample(shift)); \
+            *pixel = (GFX_RGB(0, 0, 0) & mask) | (*pixel & ~mask); \
+            current += step; \
+        } \
+    } \
+    static void column_masked_shaded_##name(params) { \
+        for (; count > 0; count--, pixel += pitch) { \
+            gfx_color texel = sample(shift); \
+            gfx_color mask = COLUMN_MASK(texel); \
+            *pixel = (SHADE_COLOR(shade, texel) & mask) | (*pixel & ~mask); \
+            current += step; \
+        } \
+    } \
+    static void column_masked_full_##name(params) { \
+        (void)shade; \
+        for (; count > 0; count--, pixel += pitch) { \
+            gfx_color texel = sample(shift); \
+            gfx_color mask = COLUMN_MASK(texel); \
+            *pixel = ((texel | GFX_RGB(0, 0, 0)) & mask) | (*pixel & ~mask); \
+            current += step; \
+        } \
+    }
+
+#define COLUMN_KERNELS(shift)           COLUMN_KERNEL_SET(shift, shift, COLUMN_PARAMS, COLUMN_TEXEL) \
+                                        COLUMN_KERNEL_SET(fixed_##shift, shift, COLUMN_FIXED_PARAMS, COLUMN_FIXED_TEXEL)
+
+#define COLUMN_ENTRY(name) { \
+    { column_opaque_dark_##name, column_opaque_shaded_##name, column_opaque_full_##name }, \
+    { column_masked_dark_##name, column_masked_shaded_##name, column_masked_full_##name } }
+
+COLUMN_KERNELS(0)
+COLUMN_KERNELS(1)
+COLUMN_KERNELS(2)
+COLUMN_KERNELS(3)
+COLUMN_KERNELS(4)
+COLUMN_KERNELS(5)
+COLUMN_KERNELS(6)
+COLUMN_KERNELS(7)
+COLUMN_KERNELS(8)
+COLUMN_KERNELS(9)
+COLUMN_KERNELS(10)
+COLUMN_KERNELS(11)
+COLUMN_KERNELS(12)
+COLUMN_KERNELS(13)
+COLUMN_KERNELS(14)
+COLUMN_KERNELS(15)
+
+/* Every kernel by the size of the column as a power of two, then format and lighting. */
+static const column_kernel column_kernels[GFX_MAX_MIP_LEVELS][COLUMN_FORMATS][COLUMN_LIGHTS] = {
+    COLUMN_ENTRY(0), COLUMN_ENTRY(1), COLUMN_ENTRY(2), COLUMN_ENTRY(3),
+    COLUMN_ENTRY(4), COLUMN_ENTRY(5), COLUMN_ENTRY(6), COLUMN_ENTRY(7),
+    COLUMN_ENTRY(8), COLUMN_ENTRY(9), COLUMN_ENTRY(10), COLUMN_ENTRY(11),
+    COLUMN_ENTRY(12), COLUMN_ENTRY(13), COLUMN_ENTRY(14), COLUMN_ENTRY(15)
+};
+static const column_fixed_kernel column_fixed_kernels[GFX_MAX_MIP_LEVELS][COLUMN_FORMATS][COLUMN_LIGHTS] = {
+    COLUMN_ENTRY(fixed_0), COLUMN_ENTRY(fixed_1), COLUMN_ENTRY(fixed_2), COLUMN_ENTRY(fixed_3),
+    COLUMN_ENTRY(fixed_4), COLUMN_ENTRY(fixed_5), COLUMN_ENTRY(fixed_6), COLUMN_ENTRY(fixed_7),
+    COLUMN_ENTRY(fixed_8), COLUMN_ENTRY(fixed_9), COLUMN_ENTRY(fixed_10), COLUMN_ENTRY(fixed_11),
+    COLUMN_ENTRY(fixed_12), COLUMN_ENTRY(fixed_13), COLUMN_ENTRY(fixed_14), COLUMN_ENTRY(fixed_15)
+};
+
+/* The kernels that each bitmap uses for each of its mip levels. */
+typedef struct {
+    column_kernel kernels[GFX_MAX_MIP_LEVELS][COLUMN_LIGHTS];
+    column_fixed_kernel fixed_kernels[GFX_MAX_MIP_LEVELS][COLUMN_LIGHTS];
+} column_levels;
+static column_levels* column_picked = NULL;
+static int column_picked_count = 0;
+
+int column_pick(int bitmap) {
+    int height, levels, format, level, light, shift;
+
+    if (bitmap < 0)
+        return -1;
+    /* Make room for every bitmap up to this one. */
+    if (bitmap >= column_picked_count) {
+        column_levels* grown = (column_levels*)realloc(column_picked, (size_t)(bitmap + 1) * sizeof(column_levels));
+        if (grown == NULL)
+            return -1;
+        memset(grown + column_picked_count, 0, (size_t)(bitmap + 1 - column_picked_count) * sizeof(column_levels));
+        column_picked = grown;
+        column_picked_count = bitmap + 1;
+    }
+    memset(&column_picked[bitmap], 0, sizeof(column_levels));
+
+    levels = gfx_get_bitmap_levels(bitmap);
+    height = gfx_get_bitmap_height(bitmap);
+    /* Only bitmaps that actually have see through texels pay for the masking. */
+    format = gfx_get_bitmap_masked(bitmap) ? COLUMN_MASKED : COLUMN_OPAQUE;
+
+    for (level = 0; level < levels; level++) {
+        for (shift = 0; (1 << shift) < GFX_MIP_SIZE(height, level); shift++)
+            ;
+        for (light = 0; light < COLUMN_LIGHTS; light++) {
+            column_picked[bitmap].kernels[level][light] = column_kernels[shift][format][light];
+            column_picked[bitmap].fixed_kernels[level][light] = column_fixed_kernels[shift][format][light];
+        }
+    }
+    return 0;
+}
+
+void column_free(void) {
+    free(column_picked);
+    column_picked = NULL;
+    column_picked_count = 0;
+}
+
+column_kernel column_get(int bitmap, int level, int light) {
+    if (bitmap < 0 || bitmap >= column_picked_count || level < 0 || level >= GFX_MAX_MIP_LEVELS || light < 0 || light >= COLUMN_LIGHTS)
+        return NULL;
+    return column_picked[bitmap].kernels[level][light];
+}
+
+column_fixed_kernel column_get_fixed(int bitmap, int level, int light) {
+    if (bitmap < 0 || bitmap >= column_picked_count || level < 0 || level >= GFX_MAX_MIP_LEVELS || light < 0 || light >= COLUMN_LIGHTS)
+        return NULL;
+    return column_picked[bitmap].fixed_kernels[level][light];
+}
\ No newline at end of file
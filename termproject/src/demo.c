@@ -1,18 +1,96 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
 #include <math.h>
+#include <SDL.h>
+#include "actor.h"
+#include "column.h"
 #include "demo.h"
+#include "fixed.h"
 #include "gfx.h"
+#include "map.h"
+#include "pool.h"
+#include "prof.h"
+#include "ray.h"
+#include "shade.h"
+#include "sprite.h"
 
-#define MAP_WIDTH                       (10)
-#define MAP_HEIGHT                      (20)
-#define MAX_LIGHT                       (10)
+#define LEVEL_WIDTH                     (10)
+#define LEVEL_HEIGHT                    (20)
+#define CEILING_COLOR                   GFX_RGB(80, 80, 80)
+#define FLOOR_COLOR                     GFX_RGB(10, 10, 10)
+/* How many screen columns or rows a worker takes at a time when drawing. */
+#define COLUMN_CHUNK                    (8)
+#define ROW_CHUNK                       (8)
+/* Floors and ceilings can only use the first few bitmaps since every row of the
+ * screen works out which mip level to use for each of them. */
+#define SURFACE_BITMAPS                 (8)
+/* Further than any span goes, for a row that never leaves a block along one axis. */
+#define DEMO_SPAN_FOREVER               (1 << 30)
+/* The size of the sprite bitmap and how far across the orb on it is. */
+#define SPRITE_BITMAP_SIZE              (32)
+#define SPRITE_RADIUS                   (12.0f)
+/* How far in front of the camera the use key reaches. */
+#define DEMO_REACH                      (1.0f)
 
 /* Camera variables */
 static float camera_x = 5.0f, camera_y = 5.0f;
 static float camera_dir_x = -1.0f, camera_dir_y = 0.0f;
 static float plane_x = 0.0f, plane_y = 0.66f;
-static int bricks = 0, steel = 0;
+static int bricks = 0, steel = 0, orb = -1;
+/* Whether the use key was held on the last tick, it only does anything when pressed. */
+static int demo_use_held = 0;
+/* The cells of the map count from 1 into the bitmaps that were loaded for the walls,
+ * which are always the first ones. Anything made after them, like the sprites, is
+ * past this and never gets drawn on a wall, floor or ceiling. */
+static int demo_walls = 0;
+/* The most that the screen can be and how much of it is drawn right now. */
+static int demo_max_width = 0, demo_max_height = 0;
+static int demo_width = 0, demo_height = 0;
+/* The workers that every frame and every batch of views gets drawn on. */
+static pool* demo_pool = NULL;
+/* Whether frames get drawn with the fixed point renderer. It can be switched while
+ * another thread is drawing so it is only looked at once at the start of each frame. */
+static SDL_atomic_t demo_fixed_point;
 
-static int map[MAP_WIDTH][MAP_HEIGHT] = {
+/* Everything that one view needs of its own while it is being drawn. The map, the
+ * bitmaps and the sprites are only ever read so every view shares those. */
+typedef struct {
+    ray_camera camera;
+    gfx_color* pixels;
+    int pitch;
+    int width, height;
+    /* Where the ray for each column of the screen ended up. */
+    ray_hit* hits;
+    /* The rows of each column that the wall covers, the end is not included. */
+    int* wall_start;
+    int* wall_end;
+    /* How far away the wall on each column is so that sprites behind it get hidden. */
+    float* depth;
+    sprite_view sprites;
+    /* Whether this frame is being drawn in fixed point. */
+    int fixed_point;
+} demo_frame;
+
+/* One pass of drawing over some columns or rows of a frame. */
+typedef void (*demo_pass)(demo_frame* frame, int begin, int end);
+
+/* Frames that get drawn together. Their columns or rows are laid end to end so the
+ * workers can take a chunk of any of them and one pass runs over all of the frames. */
+typedef struct {
+    demo_frame* frames;
+    int count;
+    int rows;
+    demo_pass pass;
+} demo_batch;
+
+/* The frame that the demo camera gets drawn into and where the sprites were for it. */
+static demo_frame demo_main;
+static float* demo_sprite_x = NULL;
+static float* demo_sprite_y = NULL;
+
+/* The level that gets used when no map is given. */
+static const unsigned char level[LEVEL_WIDTH][LEVEL_HEIGHT] = {
     { 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
     { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
     { 2, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
@@ -25,42 +103,240 @@ static int map[MAP_WIDTH][MAP_HEIGHT] = {
     { 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }
 };
 
-void demo_init(void) {
-    camera_x = 2.0f;
-    camera_y = 2.0f;
+/* Makes a glowing orb with see through corners for the sprites. */
+static int demo_generate_orb(void) {
+    gfx_color texels[SPRITE_BITMAP_SIZE * SPRITE_BITMAP_SIZE];
+    int x, y;
+
+    for (y = 0; y < SPRITE_BITMAP_SIZE; y++) {
+        for (x = 0; x < SPRITE_BITMAP_SIZE; x++) {
+            /* The orb sits on the bottom of the bitmap so that it rests on the floor. */
+            float dx = (float)x + 0.5f - SPRITE_BITMAP_SIZE / 2.0f;
+            float dy = (float)y + 0.5f - (SPRITE_BITMAP_SIZE - SPRITE_RADIUS);
+            float edge = sqrtf(dx * dx + dy * dy) / SPRITE_RADIUS;
+            int glow = (int)(255.0f * (1.0f - edge * edge));
+
+            if (edge >= 1.0f) {
+                texels[y * SPRITE_BITMAP_SIZE + x] = GFX_ARGB(0, 0, 0, 0);
+                continue;
+            }
+            texels[y * SPRITE_BITMAP_SIZE + x] = GFX_ARGB(255, 255, 128 + glow / 2, glow / 4);
+        }
+    }
+    return gfx_create_bitmap(SPRITE_BITMAP_SIZE, SPRITE_BITMAP_SIZE, texels, SPRITE_BITMAP_SIZE);
+}
+
+/* Scatters sprites over empty cells of the map, each one with an actor to walk it
+ * around. The same map always gets the same sprites heading the same ways. */
+static void demo_spawn_sprites(int count) {
+    const map_data* map = map_get_data();
+    unsigned int seed = 1;
+    int tries = count * 16;
+
+    sprite_clear();
+    while (sprite_get_count() < count && tries-- > 0) {
+        int x, y;
+
+        seed = seed * 1103515245u + 12345u;
+        x = (int)((seed >> 8) % (unsigned int)map->width);
+        seed = seed * 1103515245u + 12345u;
+        y = (int)((seed >> 8) % (unsigned int)map->height);
+        if (map_get(x, y) == 0) {
+            float angle = (float)((seed >> 16) & 1023) * (6.2831853f / 1024.0f);
+            sprite_add((float)x + 0.5f, (float)y + 0.5f, orb);
+            actor_add((float)x + 0.5f, (float)y + 0.5f, angle);
+        }
+    }
+}
+
+static void demo_frame_free(demo_frame* frame) {
+    free(frame->hits);
+    free(frame->wall_start);
+    free(frame->wall_end);
+    free(frame->depth);
+    sprite_view_free(&frame->sprites);
+    frame->hits = NULL;
+    frame->wall_start = NULL;
+    frame->wall_end = NULL;
+    frame->depth = NULL;
+}
+
+/* Makes room for everything kept per column of a frame up to width columns wide. */
+static int demo_frame_init(demo_frame* frame, int width) {
+    memset(frame, 0, sizeof(demo_frame));
+    frame->hits = (ray_hit*)malloc((size_t)width * sizeof(ray_hit));
+    frame->wall_start = (int*)malloc((size_t)width * sizeof(int));
+    frame->wall_end = (int*)malloc((size_t)width * sizeof(int));
+    frame->depth = (float*)malloc((size_t)width * sizeof(float));
+    if (frame->hits == NULL || frame->wall_start == NULL || frame->wall_end == NULL || frame->depth == NULL ||
+        sprite_view_init(&frame->sprites) != 0) {
+        demo_frame_free(frame);
+        return -1;
+    }
+    return 0;
+}
+
+int demo_init(const demo_config* config) {
+    int x, y;
+
+    /* Load the map from a file if we have one, otherwise make one. */
+    if (config->map != NULL) {
+        if (map_load(config->map) != 0)
+            return -1;
+    } else if (config->map_size > 0) {
+        if (map_generate(config->map_size, config->map_size, 1) != 0)
+            return -1;
+    } else {
+        if (map_create(LEVEL_WIDTH, LEVEL_HEIGHT) != 0)
+            return -1;
+        for (x = 0; x < LEVEL_WIDTH; x++) {
+            for (y = 0; y < LEVEL_HEIGHT; y++) {
+                map_set(x, y, level[x][y]);
+                map_set_floor(x, y, 2);
+                map_set_ceiling(x, y, 1);
+            }
+        }
+        map_set_spawn(2.0f, 2.0f);
+        if (map_build_distance() != 0)
+            return -1;
+    }
+
+    camera_x = map_get_data()->spawn_x;
+    camera_y = map_get_data()->spawn_y;
     camera_dir_x = -1.0f;
     camera_dir_y = 0.0f;
     plane_x = 0.0f;
     plane_y = 0.66f;
+    demo_use_held = 0;
+
+    /* Everything in a bundle gets a bitmap in the order that it was packed, which is
+     * the order that the cells of the map refer to them in. */
+    if (config->bundle != NULL) {
+        if (gfx_load_bundle(config->bundle) < 0)
+            return -1;
+        steel = gfx_find_bitmap("steel.bmp");
+        bricks = gfx_find_bitmap("bricks.bmp");
+    } else {
+        steel = gfx_generate_bitmap("steel.bmp");
+        bricks = gfx_generate_bitmap("bricks.bmp");
+    }
+    demo_walls = gfx_get_bitmap_count();
+    orb = demo_generate_orb();
+    /* Work out which column kernels each bitmap draws with now rather than every column. */
+    for (x = 0; x < gfx_get_bitmap_slots(); x++) {
+        if (column_pick(x) != 0)
+            return -1;
+    }
+    /* Every column of the screen can be drawn on its own so we spread them
+     * out over all the cores. */
+    demo_pool = pool_create(config->workers);
+    if (demo_pool == NULL)
+        return -1;
+    if (sprite_init(config->sprites) != 0 || actor_init(config->sprites, config->workers) != 0)
+        return -1;
+    if (orb >= 0)
+        demo_spawn_sprites(config->sprites);
+
+    /* Everything that is kept per column or per row is sized for the largest the
+     * screen can be so that it never has to change while drawing. */
+    demo_max_width = config->width > 0 ? config->width : DEMO_WIDTH;
+    demo_max_height = config->height > 0 ? config->height : DEMO_HEIGHT;
+    demo_sprite_x = (float*)malloc((size_t)(config->sprites > 0 ? config->sprites : 1) * sizeof(float));
+    demo_sprite_y = (float*)malloc((size_t)(config->sprites > 0 ? config->sprites : 1) * sizeof(float));
+    if (demo_sprite_x == NULL || demo_sprite_y == NULL || demo_frame_init(&demo_main, demo_max_width) != 0)
+        return -1;
+    demo_width = demo_max_width;
+    demo_height = demo_max_height;
+
+    /* Use the best vector instructions that the processor has unless we were told otherwise. */
+    ray_set_map(map_get_data());
+    ray_select_isa(config->isa);
+    demo_set_max_light(config->max_light);
+    fixed_init();
+    demo_set_fixed_point(config->fixed_point);
+    return 0;
+}
+
+void demo_set_max_light(float max_light) {
+    shade_set_max_light(max_light);
+}
+
+void demo_set_fixed_point(int fixed_point) {
+    SDL_AtomicSet(&demo_fixed_point, fixed_point != 0);
+}
+
+int demo_get_fixed_point(void) {
+    return SDL_AtomicGet(&demo_fixed_point);
+}
+
+void demo_set_resolution(int width, int height) {
+    /* Any width will do since the last chunk of columns can be a short one. The floor
+     * and ceiling need the horizon right on a row boundary though, so the height gets
+     * made even once it is in range, the largest height might not be. */
+    if (width < 1)
+        width = 1;
+    if (width > demo_max_width)
+        width = demo_max_width;
+    if (height < 2)
+        height = 2;
+    if (height > demo_max_height)
+        height = demo_max_height;
+    if (height > 1)
+        height -= height % 2;
+
+    demo_width = width;
+    demo_height = height;
+}
 
-    steel = gfx_generate_bitmap("steel.bmp");
-    bricks = gfx_generate_bitmap("bricks.bmp");
+int demo_get_width(void) {
+    return demo_width;
+}
+
+int demo_get_height(void) {
+    return demo_height;
+}
+
+int demo_get_workers(void) {
+    return pool_get_workers(demo_pool);
 }
 
 void demo_free(void) {
+    sprite_free();
+    column_free();
+    gfx_free_bitmap(orb);
     gfx_free_bitmap(bricks);
     gfx_free_bitmap(steel);
+    demo_walls = 0;
+    actor_free();
+    pool_free(demo_pool);
+    demo_pool = NULL;
+    map_free();
+    demo_frame_free(&demo_main);
+    free(demo_sprite_x);
+    free(demo_sprite_y);
+    demo_sprite_x = NULL;
+    demo_sprite_y = NULL;
 }
 
-void demo_tick(float delta_time, int* keys) {
+void demo_move_camera(ray_camera* camera, float delta_time, const int* keys) {
     float walk = 5.0f * delta_time;
     float turn = 3.0f * delta_time;
 
     if (keys[DEMO_INPUT_UP] == 1)
     {
         /* Move forward in the direction we are facing but clamp to the walls. */
-        if (map[(int)(camera_x + camera_dir_x * walk)][(int)camera_y] == 0)
-            camera_x += camera_dir_x * walk;
-        if (map[(int)camera_x][(int)(camera_y + camera_dir_y * walk)] == 0)
-            camera_y += camera_dir_y * walk;
+        if (map_get((int)(camera->x + camera->dir_x * walk), (int)camera->y) == 0)
+            camera->x += camera->dir_x * walk;
+        if (map_get((int)camera->x, (int)(camera->y + camera->dir_y * walk)) == 0)
+            camera->y += camera->dir_y * walk;
     }
     if (keys[DEMO_INPUT_DOWN] == 1)
     {
         /* Move backwards in the direction we are facing but clamp to the walls. */
-        if (map[(int)(camera_x - camera_dir_x * walk)][(int)camera_y] == 0)
-            camera_x -= camera_dir_x * walk;
-        if (map[(int)camera_x][(int)(camera_y - camera_dir_y * walk)] == 0)
-            camera_y -= camera_dir_y * walk;
+        if (map_get((int)(camera->x - camera->dir_x * walk), (int)camera->y) == 0)
+            camera->x -= camera->dir_x * walk;
+        if (map_get((int)camera->x, (int)(camera->y - camera->dir_y * walk)) == 0)
+            camera->y -= camera->dir_y * walk;
     }
     if (keys[DEMO_INPUT_LEFT] == 1 || keys[DEMO_INPUT_RIGHT] == 1)
     {
@@ -73,177 +349,608 @@ void demo_tick(float delta_time, int* keys) {
             final_turn = -turn;
 
         /* Rotate to the left, both camera direction and the entire camera plane need to be rotated. */
-        prev_dir_x = camera_dir_x;
-        prev_plane_x = plane_x;
-        camera_dir_x = camera_dir_x * cosf(final_turn) - camera_dir_y * sinf(final_turn);
-        camera_dir_y = prev_dir_x * sinf(final_turn) + camera_dir_y * cosf(final_turn);
-        plane_x = plane_x * cosf(final_turn) - plane_y * sinf(final_turn);
-        plane_y = prev_plane_x * sinf(final_turn) + plane_y * cosf(final_turn);
+        prev_dir_x = camera->dir_x;
+        prev_plane_x = camera->plane_x;
+        camera->dir_x = camera->dir_x * cosf(final_turn) - camera->dir_y * sinf(final_turn);
+        camera->dir_y = prev_dir_x * sinf(final_turn) + camera->dir_y * cosf(final_turn);
+        camera->plane_x = camera->plane_x * cosf(final_turn) - camera->plane_y * sinf(final_turn);
+        camera->plane_y = prev_plane_x * sinf(final_turn) + camera->plane_y * cosf(final_turn);
     }
 }
 
-void demo_draw(void) {
+void demo_tick(float delta_time, int* keys) {
+    ray_camera camera;
+
+    demo_get_camera(&camera);
+    demo_move_camera(&camera, delta_time, keys);
+    camera_x = camera.x;
+    camera_y = camera.y;
+    camera_dir_x = camera.dir_x;
+    camera_dir_y = camera.dir_y;
+    plane_x = camera.plane_x;
+    plane_y = camera.plane_y;
+
+    /* The map can not change in the middle of a tick since the renderer could be looking
+     * at it, so the change gets queued and goes in before the next frame. */
+    if (keys[DEMO_INPUT_USE] == 1 && !demo_use_held) {
+        int x = (int)(camera_x + camera_dir_x * DEMO_REACH);
+        int y = (int)(camera_y + camera_dir_y * DEMO_REACH);
+        int cell = map_get(x, y);
+
+        if (cell > 0)
+            map_queue_set(x, y, 0);
+        else if (cell == 0 && (x != (int)camera_x || y != (int)camera_y))
+            map_queue_set(x, y, 1);
+    }
+    demo_use_held = keys[DEMO_INPUT_USE] == 1;
+
+    /* Everyone else moves on the same tick as the camera. */
+    actor_tick(delta_time);
+}
+
+static void demo_draw_columns(demo_frame* frame, int begin, int end) {
     int x = 0;
-    int y = 0;
+    int width = frame->width;
+    int height = frame->height;
+    /* We draw straight into the framebuffer. */
+    int pitch = frame->pitch;
+    gfx_color* pixels = frame->pixels;
 
     /* We are going to need to send out a ray along each column of
      * the screen. We do not need to loop every pixel. We are going to
      * look at each column of the screen and figure out where we draw the
-     * wall for that line. */
-    for (x = 0; x < DEMO_WIDTH; x++) {
-        /* Get the x-coordinate on the camera plane. This is the traditional camera plane
-         * where 0 is in the center, -1 on the left, etc. We will use this to figure out
-         * where our ray is. */
-        float x_in_camera = (2 * x) / (float)(DEMO_WIDTH) - 1;
-        /* Calculate the position of the ray and the direction. */
-        float ray_dir_x = camera_dir_x + plane_x * x_in_camera;
-        float ray_dir_y = camera_dir_y + plane_y * x_in_camera;
-        /* Figure out the distances between blocks in the map that our ray has to travel throuh. This
-         * is done to prevent stepping along the ray which has the chance of missing a wall. To prevent,
-         * that we are using DDA ray collision detection. */
-        float delta_dist_x;
-        float delta_dist_y;
-        /* Which block on the map we are in. */
-        int map_x = (int)camera_x;
-        int map_y = (int)camera_y;
-        /* Length of the ray from the current position to the next x or y side of the next block in the map. */
-        float side_dist_x;
-        float side_dist_y;
-        /* The length of the ray. */
-        float perp_wall_dist;
-        /* The direction that the ray will be stepping in. */
-        int step_x;
-        int step_y;
-        /* Did the ray hit a wall? */
-        int hit = 0;
-        /* Was it a horizontal or vertcal face of the wall that we hit? */
-        int side;
+     * wall for that line. The rays for all of our columns get traced at
+     * once since the vector code can do a few of them side by side. */
+    PROF_BEGIN(dda);
+    if (frame->fixed_point)
+        ray_cast_fixed(&frame->camera, width, height, begin, end, frame->hits + begin);
+    else
+        ray_cast(&frame->camera, width, height, begin, end, frame->hits + begin);
+    PROF_END(dda, "dda");
+
+    PROF_BEGIN(walls);
+    for (x = begin; x < end; x++) {
+        const ray_hit* hit = &frame->hits[x];
         /* The position of the wall on the column that we are drawing. */
-        int line_height, line_start, line_end;
-        /* The coloring of the wall. */
-        int c_r, c_g, c_b, bitmap;
+        int line_height, line_start, line_end, wall_end;
+        /* The bitmap on the wall. */
+        int bitmap;
         /* Used to sample the wall bitmap's horizontal offset. */
-        float wall_x;
-        int bitmap_x;
-        /* Scaling factor to use when stepping through the bitmap during the drawing. */
-        float bitmap_step;
-        float bitmap_current;
-
-        if (ray_dir_x == 0) {
-            delta_dist_x = 0;
-            delta_dist_y = 0;
-        } else if (ray_dir_y == 0) {
-            delta_dist_x = 1;
-            delta_dist_y = 1;
+        int bitmap_x, bitmap_width, bitmap_height, bitmap_mask;
+        /* Which level of the bitmap's mip chain we draw from. */
+        int level, levels;
+        const gfx_color* bitmap_column;
+        /* The loop that draws the column, made for this size of bitmap and lighting. */
+        column_kernel kernel;
+        int shade_level;
+        /* The pixel in the framebuffer that we are drawing to, starting at the top of the column. */
+        gfx_color* pixel = pixels + x;
+
+        /* Recall how we are drawing the screen based on columns. We now need to figure out where the sliver
+         * of wall that is on our column goes. */
+        line_height = hit->line_height;
+
+        line_start = -line_height / 2 + height / 2;
+        if (line_start < 0)
+            line_start = 0;
+        if (line_start > height)
+            line_start = height;
+
+        line_end = line_height / 2 + height / 2;
+        if (line_end > height)
+            line_end = height;
+
+        /* Pick the color of the line. We do this by sampling the correct bitmap.
+         * We subtract one to account for the fact that 0 is an empty space in the
+         * map but it is a legal bitmap index. A cell past the wall bitmaps has none. */
+        bitmap = hit->cell - 1;
+        if (bitmap >= demo_walls)
+            bitmap = -1;
+        bitmap_width = gfx_get_bitmap_width(bitmap);
+        bitmap_height = gfx_get_bitmap_height(bitmap);
+        levels = gfx_get_bitmap_levels(bitmap);
+
+        /* A far away wall would skip over lots of texels for every pixel which reads from
+         * all over the bitmap and makes it shimmer as we move. Go down the mip chain until
+         * each pixel on the screen covers less than two texels. */
+        level = 0;
+        while (level + 1 < levels && GFX_MIP_SIZE(bitmap_height, level) / 2 >= line_height)
+            level++;
+        bitmap_width = GFX_MIP_SIZE(bitmap_width, level);
+        bitmap_mask = GFX_MIP_SIZE(bitmap_height, level) - 1;
+
+        /* Convert wall coordinate to bitmap. */
+        if (frame->fixed_point)
+            bitmap_x = (hit->fixed_wall_x * bitmap_width) >> FIXED_SHIFT;
+        else
+            bitmap_x = (int)(hit->wall_x * (float)bitmap_width);
+        if ((hit->side == 0 && hit->ray_dir_x > 0) || (hit->side == 1 && hit->ray_dir_y < 0))
+            bitmap_x = bitmap_width - bitmap_x - 1;
+        /* The whole column of the bitmap that we are going to walk down. If the ray
+         * never found a wall or went somewhere strange and there is no column then
+         * skip the wall. */
+        bitmap_column = gfx_get_bitmap_mip_column(bitmap, level, bitmap_x);
+        shade_level = frame->fixed_point ? shade_get_level_fixed(hit->fixed_perp_wall_dist) : shade_get_level(hit->perp_wall_dist);
+        /* Both kinds of kernel get picked together so either one says if there is one. */
+        kernel = column_get(bitmap, level, COLUMN_LIGHT(shade_level));
+        if (hit->cell == 0 || bitmap_column == NULL || kernel == NULL) {
+            line_start = height;
+            line_end = -1;
+        }
+
+        /* The wall covers everything from the start of the line up to and including the end. */
+        wall_end = line_end < height ? line_end + 1 : height;
+        if (wall_end < line_start)
+            wall_end = line_start;
+
+        /* Remember which part of the column the wall covers for the floor and ceiling. */
+        frame->wall_start[x] = line_start;
+        frame->wall_end[x] = wall_end;
+        frame->depth[x] = line_start < wall_end ? hit->perp_wall_dist : FLT_MAX;
+
+        if (line_start >= wall_end)
+            continue;
+
+        /* Walk down the bitmap column and light each texel on the way to the screen. The
+         * kernel masks with the height to make sure that we don't end up rouning up. */
+        if (frame->fixed_point) {
+            /* The same stepping in fixed point. The start is worked out from the middle of
+             * the bitmap being at the middle of the screen, so that on a line so tall the
+             * step rounds down to almost nothing we still end up on the right texels. */
+            fixed fixed_step = fixed_divide(bitmap_mask + 1, line_height);
+            unsigned int fixed_current = (unsigned int)((bitmap_mask + 1) * (FIXED_ONE / 2) +
+                (long long)(2 * line_start - height) * fixed_step / 2);
+
+            column_get_fixed(bitmap, level, COLUMN_LIGHT(shade_level))(pixel + line_start * pitch, pitch, wall_end - line_start,
+                bitmap_column, fixed_current, (unsigned int)fixed_step, shade_get_table(shade_level));
+        } else {
+            /* Figure out how much to increase the bitmap offset by per screen pixel. */
+            float bitmap_step = 1.0f * (float)(bitmap_mask + 1) / (float)line_height;
+            float bitmap_current = ((float)line_start - (float)height / 2.0f + (float)line_height / 2.0f) * bitmap_step;
+
+            kernel(pixel + line_start * pitch, pitch, wall_end - line_start, bitmap_column, bitmap_current, bitmap_step, shade_get_table(shade_level));
+        }
+    }
+    PROF_END(walls, "walls");
+}
+
+/* Where the floor or ceiling under a row of the screen is and how to texture it. */
+typedef struct {
+    /* The spot on the map under the first pixel and how far to move for every pixel after it. */
+    float start_x, start_y;
+    float step_x, step_y;
+    /* The same in fixed point when the frame is drawn that way. */
+    fixed fixed_start_x, fixed_start_y;
+    fixed fixed_step_x, fixed_step_y;
+    /* Which bitmap each surface in the map uses on this row. */
+    const unsigned char* surfaces;
+    const gfx_color* texels[SURFACE_BITMAPS];
+    int width[SURFACE_BITMAPS];
+    int height[SURFACE_BITMAPS];
+    const unsigned char* shade;
+    gfx_color plain;
+} demo_row;
+
+/* Which bitmap the surface in a block of the map uses, or -1 if it gets a plain color.
+ * That includes everywhere off the edge of the map. */
+static int demo_row_bitmap(const demo_row* row, const map_data* map, int cell_x, int cell_y) {
+    int bitmap;
+
+    if (cell_x < 0 || cell_y < 0 || cell_x >= map->width || cell_y >= map->height)
+        return -1;
+    bitmap = row->surfaces[MAP_INDEX(map->tiles_x, cell_x, cell_y)] - 1;
+    if (bitmap < 0 || bitmap >= SURFACE_BITMAPS || row->texels[bitmap] == NULL)
+        return -1;
+    return bitmap;
+}
+
+/* How many pixels it takes along a row to leave a block along one axis, from where the
+ * row is now. The floats round so it can be a pixel out, demo_draw_span checks it. */
+static int demo_span_steps(float value, float step, int cell) {
+    float steps;
+
+    if (step > 0.0f)
+        steps = ceilf(((float)(cell + 1) - value) / step);
+    else if (step < 0.0f)
+        steps = floorf(((float)cell - value) / step) + 1.0f;
+    else
+        return DEMO_SPAN_FOREVER;
+    if (!(steps < (float)DEMO_SPAN_FOREVER))
+        return DEMO_SPAN_FOREVER;
+    return steps > 1.0f ? (int)steps : 1;
+}
+
+/* Whether the spot under pixel x of a row is in the given block. */
+static int demo_span_inside(const demo_row* row, int x, int cell_x, int cell_y) {
+    return (int)floorf(row->start_x + row->step_x * (float)x) == cell_x &&
+        (int)floorf(row->start_y + row->step_y * (float)x) == cell_y;
+}
+
+/* Textures the floor or ceiling from begin up to end on one row. The span gets split
+ * into runs that each stay inside one block of the map, so the map and the bitmap only
+ * get looked at once a run. Inside a run every pixel works out its texel from its own x
+ * and nothing else, so the loop has no branches and nothing carried between pixels. */
+static void demo_draw_span(const demo_row* row, const map_data* map, gfx_color* pixels, int begin, int end) {
+    const unsigned char* shade = row->shade;
+    int x = begin;
+
+    while (x < end) {
+        float floor_x = row->start_x + row->step_x * (float)x;
+        float floor_y = row->start_y + row->step_y * (float)x;
+        int cell_x = (int)floorf(floor_x);
+        int cell_y = (int)floorf(floor_y);
+        int steps_x = demo_span_steps(floor_x, row->step_x, cell_x);
+        int steps_y = demo_span_steps(floor_y, row->step_y, cell_y);
+        int run = end - x;
+        int bitmap, i;
+
+        if (steps_x < run)
+            run = steps_x;
+        if (steps_y < run)
+            run = steps_y;
+        run += x;
+        /* Every pixel goes the same way along both axes, so making sure that the last
+         * pixel is still in the block and the next one is not is enough. */
+        while (run > x + 1 && !demo_span_inside(row, run - 1, cell_x, cell_y))
+            run--;
+        while (run < end && demo_span_inside(row, run, cell_x, cell_y))
+            run++;
+
+        bitmap = demo_row_bitmap(row, map, cell_x, cell_y);
+        if (bitmap < 0) {
+            for (i = x; i < run; i++)
+                pixels[i] = row->plain;
         } else {
-            delta_dist_x = fabsf(1.0f / ray_dir_x);
-            delta_dist_y = fabsf(1.0f / ray_dir_y);
+            const gfx_color* texels = row->texels[bitmap];
+            int height = row->height[bitmap];
+            int mask_x = row->width[bitmap] - 1;
+            int mask_y = height - 1;
+            float scale_x = (float)row->width[bitmap];
+            float scale_y = (float)height;
+
+            /* The bitmaps are a power of two so the mask wraps them around every block. */
+            for (i = x; i < run; i++) {
+                int texel_x = (int)((row->start_x + row->step_x * (float)i) * scale_x) & mask_x;
+                int texel_y = (int)((row->start_y + row->step_y * (float)i) * scale_y) & mask_y;
+                pixels[i] = SHADE_COLOR(shade, texels[texel_x * height + texel_y]);
+            }
         }
+        x = run;
+    }
+}
+
+/* The same as demo_span_steps in fixed point, where the row moves exactly the same amount
+ * every pixel so the answer is exact. */
+static int demo_span_steps_fixed(fixed value, fixed step, int cell) {
+    long long left;
+
+    if (step > 0) {
+        left = (long long)(cell + 1) * FIXED_ONE - value;
+        return (int)((left + step - 1) / step);
+    }
+    if (step < 0) {
+        left = value - (long long)cell * FIXED_ONE + 1;
+        return (int)((left - step - 1) / -step);
+    }
+    return DEMO_SPAN_FOREVER;
+}
+
+/* The same as demo_draw_span in fixed point. */
+static void demo_draw_span_fixed(const demo_row* row, const map_data* map, gfx_color* pixels, int begin, int end) {
+    const unsigned char* shade = row->shade;
+    int x = begin;
 
-        /* Calculate the step direction and the starting side distance. */
-        if (ray_dir_x < 0.0f) {
-            step_x = -1;
-            side_dist_x = (camera_x - map_x) * delta_dist_x;
+    while (x < end) {
+        fixed floor_x = row->fixed_start_x + row->fixed_step_x * x;
+        fixed floor_y = row->fixed_start_y + row->fixed_step_y * x;
+        int cell_x = FIXED_TO_INT(floor_x);
+        int cell_y = FIXED_TO_INT(floor_y);
+        int steps_x = demo_span_steps_fixed(floor_x, row->fixed_step_x, cell_x);
+        int steps_y = demo_span_steps_fixed(floor_y, row->fixed_step_y, cell_y);
+        int run = end - x;
+        int bitmap, i;
+
+        if (steps_x < run)
+            run = steps_x;
+        if (steps_y < run)
+            run = steps_y;
+        run += x;
+
+        bitmap = demo_row_bitmap(row, map, cell_x, cell_y);
+        if (bitmap < 0) {
+            for (i = x; i < run; i++)
+                pixels[i] = row->plain;
         } else {
-            step_x = 1;
-            side_dist_x = (map_x + 1.0f - camera_x) * delta_dist_x;
+            const gfx_color* texels = row->texels[bitmap];
+            int width = row->width[bitmap];
+            int height = row->height[bitmap];
+
+            /* Only the part inside the block picks the texel so there is nothing to wrap. */
+            for (i = x; i < run; i++) {
+                int texel_x = (((row->fixed_start_x + row->fixed_step_x * i) & FIXED_FRACTION) * width) >> FIXED_SHIFT;
+                int texel_y = (((row->fixed_start_y + row->fixed_step_y * i) & FIXED_FRACTION) * height) >> FIXED_SHIFT;
+                pixels[i] = SHADE_COLOR(shade, texels[texel_x * height + texel_y]);
+            }
         }
+        x = run;
+    }
+}
+
+/* The floor and ceiling get drawn a row of the screen at a time since everything on a row
+ * is the same distance away. That means the position only needs working out once and then
+ * it moves in a straight line across the screen. Whatever the walls already covered gets
+ * skipped over. */
+static void demo_draw_rows(demo_frame* frame, int begin, int end) {
+    const ray_camera* camera = &frame->camera;
+    const map_data* map = map_get_data();
+    int width = frame->width;
+    int height = frame->height;
+    int pitch = frame->pitch;
+    gfx_color* pixels = frame->pixels;
+    ray_fixed_camera fixed_camera;
+    fixed plane_length = 0;
+    int x, y, i;
+
+    if (frame->fixed_point) {
+        ray_camera_to_fixed(camera, &fixed_camera);
+        plane_length = fixed_length(fixed_camera.plane_x, fixed_camera.plane_y);
+    }
+
+    PROF_BEGIN(rows);
+    for (y = begin; y < end; y++) {
+        gfx_color* row_pixels = pixels + y * pitch;
+        int ceiling = y < height / 2;
+        /* How many blocks a pixel covers, across the row and between this row and the next. */
+        float footprint = 0.0f;
+        long long fixed_footprint = 0;
+        int shade;
+        demo_row row = { 0 };
+
+        /* The camera is halfway between the floor and the ceiling so rows further from the
+         * middle of the screen are closer. The middle row is at the horizon. */
+        if (frame->fixed_point) {
+            /* Everything is the same in fixed point, the whole number over whole number
+             * divide gives the distance straight away. The rows out past where the light
+             * reaches are all black whatever their distance is, so it stops there before
+             * the horizon gets far enough away to not fit. */
+            fixed distance = fixed_divide(height, ceiling ? height - 2 * y : 2 * y - height);
+            long long depth;
 
-        if (ray_dir_y < 0.0f) {
-            step_y = -1;
-            side_dist_y = (camera_y - map_y) * delta_dist_y;
+            if (distance > FIXED_FROM_INT(SHADE_MAX_DISTANCE))
+                distance = FIXED_FROM_INT(SHADE_MAX_DISTANCE);
+            depth = (((long long)distance * distance) >> FIXED_SHIFT) * 2 / height;
+            fixed_footprint = (((long long)distance * plane_length) >> FIXED_SHIFT) * 2 / width;
+            shade = shade_get_level_fixed(distance);
+            row.fixed_start_x = fixed_camera.x + FIXED_MUL(distance, fixed_camera.dir_x - fixed_camera.plane_x);
+            row.fixed_start_y = fixed_camera.y + FIXED_MUL(distance, fixed_camera.dir_y - fixed_camera.plane_y);
+            row.fixed_step_x = FIXED_MUL(distance, 2 * fixed_camera.plane_x) / width;
+            row.fixed_step_y = FIXED_MUL(distance, 2 * fixed_camera.plane_y) / width;
+            if (depth > fixed_footprint)
+                fixed_footprint = depth;
         } else {
-            step_y = 1;
-            side_dist_y = (map_y + 1.0f - camera_y) * delta_dist_y;
+            /* The same goes for float, past the furthest that anything gets lit is as far
+             * as a row ever needs to be. That keeps the horizon row, which is right at the
+             * middle and would be infinitely far away, from dividing by zero. */
+            int below = ceiling ? height - 2 * y : 2 * y - height;
+            float distance = below * SHADE_MAX_DISTANCE > height ? (float)height / (float)below : (float)SHADE_MAX_DISTANCE;
+            float depth = distance * distance * 2.0f / (float)height;
+
+            footprint = distance * 2.0f * sqrtf(camera->plane_x * camera->plane_x + camera->plane_y * camera->plane_y) / (float)width;
+            shade = shade_get_level(distance);
+            row.start_x = camera->x + distance * (camera->dir_x - camera->plane_x);
+            row.start_y = camera->y + distance * (camera->dir_y - camera->plane_y);
+            row.step_x = distance * 2.0f * camera->plane_x / (float)width;
+            row.step_y = distance * 2.0f * camera->plane_y / (float)width;
+            if (depth > footprint)
+                footprint = depth;
+        }
+        row.surfaces = ceiling ? map->ceilings : map->floors;
+        row.plain = shade_color(ceiling ? CEILING_COLOR : FLOOR_COLOR, shade);
+        row.shade = shade_get_table(shade);
+
+        /* Use the mip level that puts about one texel on each pixel, the same as the walls. */
+        for (i = 0; i < SURFACE_BITMAPS; i++) {
+            int levels = gfx_get_bitmap_levels(i);
+            int bitmap_width = gfx_get_bitmap_width(i);
+            int bitmap_height = gfx_get_bitmap_height(i);
+            int bitmap_size = bitmap_width > bitmap_height ? bitmap_width : bitmap_height;
+            int level = 0;
+
+            if (i >= demo_walls) {
+                row.texels[i] = NULL;
+                continue;
+            }
+            while (level + 1 < levels && (frame->fixed_point ?
+                GFX_MIP_SIZE(bitmap_size, level) * fixed_footprint >= 2 * FIXED_ONE :
+                (float)GFX_MIP_SIZE(bitmap_size, level) * footprint >= 2.0f))
+                level++;
+            row.texels[i] = gfx_get_bitmap_mip(i, level);
+            row.width[i] = GFX_MIP_SIZE(bitmap_width, level);
+            row.height[i] = GFX_MIP_SIZE(bitmap_height, level);
         }
 
-        /* This loop is the actuall DDA collision algorithm. It will move the ray through
-         * all the blocks in the map until it hits a wall. It is important that the level
-         * always have walls on the edge to prevent an infinite loop here. */
-        while (hit == 0) {
-            /* Jump to the next block in the map in the x direction or y direction. */
-            if (side_dist_x < side_dist_y) {
-                side_dist_x += delta_dist_x;
-                map_x += step_x;
-                side = 0;
+        /* Find each stretch of the row between the walls and fill it in. Out past where
+         * the light reaches, including at the horizon, it is all black anyway. */
+        x = 0;
+        while (x < width) {
+            int span;
+
+            while (x < width && y >= frame->wall_start[x] && y < frame->wall_end[x])
+                x++;
+            span = x;
+            while (x < width && (y < frame->wall_start[x] || y >= frame->wall_end[x]))
+                x++;
+
+            if (row.surfaces != NULL && shade > 0 && frame->fixed_point) {
+                demo_draw_span_fixed(&row, map, row_pixels, span, x);
+            } else if (row.surfaces != NULL && shade > 0) {
+                demo_draw_span(&row, map, row_pixels, span, x);
             } else {
-                side_dist_y += delta_dist_y;
-                map_y += step_y;
-                side = 1;
+                for (i = span; i < x; i++)
+                    row_pixels[i] = row.plain;
             }
+        }
+    }
+    PROF_END(rows, "floor and ceiling");
+}
 
-            /* Check to see if we hit a solid block. */
-            if (map[map_x][map_y] > 0)
-                hit = 1;
+static void demo_draw_sprites(demo_frame* frame, int begin, int end) {
+    PROF_BEGIN(sprites);
+    sprite_draw(&frame->sprites, frame->pixels, frame->pitch, frame->depth, frame->width, frame->height, begin, end);
+    PROF_END(sprites, "sprites");
+}
+
+/* Hands a chunk of the columns or rows of a batch out to the frames that they belong to. */
+static void demo_run_batch(void* data, int begin, int end) {
+    const demo_batch* batch = (const demo_batch*)data;
+    int offset = 0, i;
+
+    for (i = 0; i < batch->count && begin < end; i++) {
+        demo_frame* frame = &batch->frames[i];
+        int size = batch->rows ? frame->height : frame->width;
+
+        if (begin < offset + size) {
+            int last = end < offset + size ? end : offset + size;
+            batch->pass(frame, begin - offset, last - offset);
+            begin = last;
         }
+        offset += size;
+    }
+}
 
-        /* Calculate the distance projected in the camera direction. We will be using the camera
-         * plane to avoid the fisheye effect. If we use the real-world distance from the camera
-         * position in the scene to the wall, the distance will be longer on the sides since the
-         * ray on the side is not travelling in a straight line. The distance change will cause the
-         * wall to be drawn at a smaller size near the edges then it will in the center and cause the
-         * rounded fisheye effect. */
-        if (side == 0)
-            perp_wall_dist = (map_x - camera_x + (1 - step_x) / 2) / ray_dir_x;
-        else
-            perp_wall_dist = (map_y - camera_y + (1 - step_y) / 2) / ray_dir_y;
+static void demo_cull_sprites(void* data, int begin, int end) {
+    demo_frame* frames = (demo_frame*)data;
+    int i;
 
-        /* Recall how we are drawing the screen based on columns. We now need to figure out where the sliver
-         * of wall that is on our column goes. */
-        line_height = (int)((float)(DEMO_HEIGHT) / perp_wall_dist);
+    PROF_BEGIN(cull);
+    for (i = begin; i < end; i++)
+        sprite_cull(&frames[i].sprites, &frames[i].camera, frames[i].depth, frames[i].width, frames[i].height);
+    PROF_END(cull, "sprite cull");
+}
 
-        line_start = -line_height / 2 + DEMO_HEIGHT / 2;
-        if (line_start < 0)
-            line_start = 0;
+/* Points every frame at the newest positions of the actors. They get copied so the
+ * simulation can carry on ticking while the frames are drawn. */
+static void demo_place_sprites(demo_frame* frames, int count, float* x, float* y) {
+    int i;
 
-        line_end = line_height / 2 + DEMO_HEIGHT / 2;
-        if (line_end > DEMO_HEIGHT)
-            line_end = DEMO_HEIGHT;
+    if (actor_copy_positions(x, y) == 0)
+        return;
+    for (i = 0; i < count; i++) {
+        frames[i].sprites.x = x;
+        frames[i].sprites.y = y;
+    }
+}
 
-        /* Pick the color of the line. We do this by sampling the correct bitmap.
-         * We subtract one to account for the fact that 0 is an empty space in the
-         * map but it is a legal bitmap index. */
-        bitmap = map[map_x][map_y] - 1;
-        if (side == 0)
-            wall_x = camera_y + perp_wall_dist * ray_dir_y;
-        else
-            wall_x = camera_x + perp_wall_dist * ray_dir_x;
-        wall_x -= floorf(wall_x);
-        /* Convert wall coordinate to bitmap. */
-        bitmap_x = (int)(wall_x * (float)gfx_get_bitmap_width(bitmap));
-        if ((side == 0 && ray_dir_x > 0) || (side == 1 && ray_dir_y < 0))
-            bitmap_x = gfx_get_bitmap_width(bitmap) - bitmap_x - 1;
-
-        /* Figure out how much to increase the bitmap offset by per screen pixel. */
-        bitmap_step = 1.0f * (float)gfx_get_bitmap_height(bitmap) / (float)line_height;
-        bitmap_current = ((float)line_start - (float)DEMO_HEIGHT / 2.0f + (float)line_height / 2.0f) * bitmap_step;
-
-        /* Figure out how far the wall is and adjust the lighting to darken things that are further away. */
-        float light = (1.0f - (perp_wall_dist / MAX_LIGHT));
-        light = fmaxf(light, 0.0f);
-        light = fminf(light, 1.0f);
-
-        for (y = 0; y < DEMO_HEIGHT; y++) {
-            /* This means that the wall intersects the floor and ceiling and gets drawn instead. */
-            if (y >= line_start && y <= line_end) {
-                /* Convert to integers to allow for indexing of the color and mask with the height
-                 * to make sure that we don't end up rouning up. */
-                int bitmap_y = (int)bitmap_current & (gfx_get_bitmap_height(bitmap) - 1);
-
-                /* Get the color of that pixel on the texture. */
-                gfx_get_bitmap_color(bitmap, bitmap_x, bitmap_y, &c_r, &c_g, &c_b);
-                /* Place the pixel on screen and apply lighting. */
-                gfx_putpixel(x, y, (int)(c_r * light), (int)(c_g * light), (int)(c_b * light));
-
-                /* Move on to the next pixel. */
-                bitmap_current += bitmap_step;
-            }
-            /* We are on the top half which means we should draw the ceiling. */
-            else if (y < (DEMO_HEIGHT / 2))
-                gfx_putpixel(x, y, 80, 80, 80);
-            /* We are drawing the bottom half so we want to draw the floor. */
-            else
-                gfx_putpixel(x, y, 10, 10, 10);
+static void demo_draw_frames(demo_frame* frames, int count) {
+    demo_batch batch;
+    int fixed_point = demo_get_fixed_point();
+    int columns = 0, rows = 0, i;
+
+    for (i = 0; i < count; i++) {
+        columns += frames[i].width;
+        rows += frames[i].height;
+        frames[i].fixed_point = fixed_point;
+    }
+    batch.frames = frames;
+    batch.count = count;
+
+    /* No two columns touch the same pixels so the workers can draw them in any
+     * order and the frame always comes out the same. The floor and ceiling need
+     * to know where every wall is so they wait until all of the columns are done
+     * and then go row by row. Sprites go over the top of everything, split up by
+     * columns again since each one only has to check its own part of the depths.
+     * With more than one frame each pass covers all of them before the next one
+     * starts so that there are plenty of chunks to go around. */
+    batch.rows = 0;
+    batch.pass = demo_draw_columns;
+    pool_run(demo_pool, demo_run_batch, &batch, columns, COLUMN_CHUNK);
+    pool_run(demo_pool, demo_cull_sprites, frames, count, 1);
+    batch.rows = 1;
+    batch.pass = demo_draw_rows;
+    pool_run(demo_pool, demo_run_batch, &batch, rows, ROW_CHUNK);
+    batch.rows = 0;
+    batch.pass = demo_draw_sprites;
+    pool_run(demo_pool, demo_run_batch, &batch, columns, COLUMN_CHUNK);
+}
+
+void demo_get_camera(ray_camera* camera) {
+    camera->x = camera_x;
+    camera->y = camera_y;
+    camera->dir_x = camera_dir_x;
+    camera->dir_y = camera_dir_y;
+    camera->plane_x = plane_x;
+    camera->plane_y = plane_y;
+}
+
+void demo_draw(void) {
+    ray_camera camera;
+
+    demo_get_camera(&camera);
+    demo_draw_camera(&camera);
+}
+
+void demo_draw_camera(const ray_camera* camera) {
+    /* Let the framebuffer know how much of it this frame covers. */
+    gfx_set_size(demo_width, demo_height);
+
+    demo_main.camera = *camera;
+    demo_main.pixels = gfx_get_framebuffer(&demo_main.pitch);
+    demo_main.width = demo_width;
+    demo_main.height = demo_height;
+    demo_place_sprites(&demo_main, 1, demo_sprite_x, demo_sprite_y);
+    demo_draw_frames(&demo_main, 1);
+}
+
+int demo_draw_views(const demo_view* views, int count) {
+    demo_frame* frames;
+    int result = 0, i;
+
+    if (count <= 0)
+        return 0;
+    for (i = 0; i < count; i++) {
+        /* The horizon has to land between two rows so the height needs to be even. */
+        if (views[i].pixels == NULL || views[i].width <= 0 || views[i].height < 2 || views[i].height % 2 != 0 ||
+            views[i].pitch < views[i].width)
+            return -1;
+    }
+
+    /* Nothing that the views need of their own lives outside of this call and the
+     * rest is only read, so any number of threads can be drawing their own views at
+     * once. Only one of them gets the workers at a time though, the others draw on
+     * their own thread until the workers come free again. */
+    frames = (demo_frame*)calloc((size_t)count, sizeof(demo_frame));
+    if (frames == NULL)
+        return -1;
+    for (i = 0; i < count && result == 0; i++) {
+        if (demo_frame_init(&frames[i], views[i].width) != 0) {
+            result = -1;
+            break;
+        }
+        frames[i].camera = views[i].camera;
+        frames[i].pixels = views[i].pixels;
+        frames[i].pitch = views[i].pitch;
+        frames[i].width = views[i].width;
+        frames[i].height = views[i].height;
+    }
+
+    /* The views all share one copy of where the sprites are. */
+    if (result == 0) {
+        int sprites = actor_get_count() > 0 ? actor_get_count() : 1;
+        float* x = (float*)malloc((size_t)sprites * sizeof(float));
+        float* y = (float*)malloc((size_t)sprites * sizeof(float));
+
+        if (x != NULL && y != NULL) {
+            demo_place_sprites(frames, count, x, y);
+            demo_draw_frames(frames, count);
+        } else {
+            result = -1;
         }
+        free(x);
+        free(y);
     }
+
+    for (i = 0; i < count; i++)
+        demo_frame_free(&frames[i]);
+    free(frames);
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "fixed.h"
+
+#define FIXED_RECIPROCAL_SIZE           (1 << FIXED_RECIPROCAL_BITS)
+
+/* Any number can be shifted up or down until its top bit lands at FIXED_RECIPROCAL_BITS,
+ * which leaves it somewhere from the size of the table up to twice that. This is 2^43
+ * over each of those, with one more on the end so that there is always a next one to
+ * blend towards for the bits that were shifted off. */
+static unsigned int fixed_reciprocals[FIXED_RECIPROCAL_SIZE + 1];
+
+void fixed_init(void) {
+    int i;
+
+    for (i = 0; i <= FIXED_RECIPROCAL_SIZE; i++)
+        fixed_reciprocals[i] = (unsigned int)((1ULL << 43) / (unsigned long long)(FIXED_RECIPROCAL_SIZE + i));
+}
+
+fixed fixed_from_float(float value) {
+    /* Anything that does not fit gets clamped, and NaN comes out as 0. */
+    if (value != value)
+        return 0;
+    if (value >= 32767.0f)
+        return FIXED_MAX;
+    if (value <= -32767.0f)
+        return -FIXED_MAX;
+    return (fixed)(value * (float)FIXED_ONE);
+}
+
+float fixed_to_float(fixed value) {
+    return (float)value / (float)FIXED_ONE;
+}
+
+/* Which bit is the top one that is set, value must not be 0. */
+static int fixed_top_bit(unsigned int value) {
+    int bit = 0;
+
+    if (value >= 1u << 16) {
+        value >>= 16;
+        bit += 16;
+    }
+    if (value >= 1u << 8) {
+        value >>= 8;
+        bit += 8;
+    }
+    if (value >= 1u << 4) {
+        value >>= 4;
+        bit += 4;
+    }
+    if (value >= 1u << 2) {
+        value >>= 2;
+        bit += 2;
+    }
+    if (value >= 1u << 1)
+        bit += 1;
+    return bit;
+}
+
+/* One over value as 2^43 over its top bits, leaving where the top bit was to shift by. */
+static unsigned int fixed_lookup(unsigned int value, int* top) {
+    unsigned int index;
+
+    *top = fixed_top_bit(value);
+    if (*top > FIXED_RECIPROCAL_BITS) {
+        /* Go part of the way to the next entry for the bits below the top ones. */
+        int low = *top - FIXED_RECIPROCAL_BITS;
+        unsigned int rest = value & ((1u << low) - 1);
+
+        index = (value >> low) - FIXED_RECIPROCAL_SIZE;
+        return fixed_reciprocals[index] -
+            (unsigned int)(((unsigned long long)(fixed_reciprocals[index] - fixed_reciprocals[index + 1]) * rest) >> low);
+    }
+    index = (value << (FIXED_RECIPROCAL_BITS - *top)) - FIXED_RECIPROCAL_SIZE;
+    return fixed_reciprocals[index];
+}
+
+fixed fixed_divide(fixed numerator, fixed denominator) {
+    int negative = (numerator < 0) != (denominator < 0);
+    unsigned int top_value = numerator < 0 ? 0u - (unsigned int)numerator : (unsigned int)numerator;
+    unsigned int bottom_value = denominator < 0 ? 0u - (unsigned int)denominator : (unsigned int)denominator;
+    unsigned long long quotient;
+    unsigned int reciprocal;
+    int top;
+
+    if (bottom_value == 0)
+        return negative ? -FIXED_MAX : FIXED_MAX;
+    /* Multiplying by the reciprocal leaves 43 bits of fraction plus however many the
+     * bottom was shifted by to get its top bits, and 16 of those get kept. */
+    reciprocal = fixed_lookup(bottom_value, &top);
+    quotient = ((unsigned long long)top_value * reciprocal) >> (top + 43 - FIXED_RECIPROCAL_BITS - FIXED_SHIFT);
+    if (quotient > FIXED_MAX)
+        quotient = FIXED_MAX;
+    return negative ? -(fixed)quotient : (fixed)quotient;
+}
+
+fixed fixed_reciprocal(fixed value) {
+    return fixed_divide(FIXED_ONE, value);
+}
+
+fixed fixed_length(fixed x, fixed y) {
+    /* The squares have 32 bits of fraction, so the square root of them has 16. */
+    unsigned long long value = (unsigned long long)((long long)x * x) + (unsigned long long)((long long)y * y);
+    unsigned long long root = 0;
+    unsigned long long bit = 1ULL << 62;
+
+    /* Square root one bit at a time, most significant first. */
+    while (bit > value)
+        bit >>= 2;
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root > FIXED_MAX ? FIXED_MAX : (fixed)root;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "fmap.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+int fmap_open(const char* fname, fmap_file* file) {
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+    file->mapping = NULL;
+
+#ifdef _WIN32
+    {
+        HANDLE handle, mapping;
+        LARGE_INTEGER size;
+        void* data;
+
+        handle = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE)
+            return -1;
+        /* Windows will not map an empty file so there is nothing to do with one. */
+        if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+            CloseHandle(handle);
+            return -1;
+        }
+        mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(handle);
+            return -1;
+        }
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data == NULL) {
+            CloseHandle(mapping);
+            CloseHandle(handle);
+            return -1;
+        }
+
+        file->data = data;
+        file->size = (size_t)size.QuadPart;
+        file->handle = handle;
+        file->mapping = mapping;
+    }
+#else
+    {
+        struct stat info;
+        void* data;
+        int fd = open(fname, O_RDONLY);
+
+        if (fd < 0)
+            return -1;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            return -1;
+        }
+        data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        /* The mapping stays around after the file is closed. */
+        close(fd);
+        if (data == MAP_FAILED)
+            return -1;
+
+        file->data = data;
+        file->size = (size_t)info.st_size;
+    }
+#endif
+    return 0;
+}
+
+void fmap_close(fmap_file* file) {
+    if (file->data == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE)file->mapping);
+    CloseHandle((HANDLE)file->handle);
+#else
+    munmap((void*)file->data, file->size);
+#endif
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+    file->mapping = NULL;
+}
\ No newline at end of file
@@ -1,35 +1,564 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <SDL.h>
+#include "fmap.h"
 #include "gfx.h"
 
+#define GFX_BUNDLE_MAGIC                ("TPAK")
+#define GFX_BUNDLE_VERSION              (1)
+/* Where each block of texels starts in a bundle is rounded up to this many bytes. */
+#define GFX_BUNDLE_ALIGN                (64)
+/* The bitmap has texels that are see through. */
+#define GFX_BUNDLE_MASKED               (1)
+
 SDL_Renderer* gfx_renderer = NULL;
-SDL_Surface* gfx_textures[GFX_MAX_TEXTURES] = { NULL };
 
-int gfx_generate_bitmap(const char* fname) {
+/* Bitmaps are converted into our own packed format when they are loaded so that
+ * drawing never has to go back through SDL. We keep a transposed copy as well
+ * since the raycaster reads the walls one column at a time. The transposed copy
+ * carries the whole mip chain, each level straight after the one before it. The
+ * texels either live in memory that the bitmap owns or straight in a mapped bundle. */
+typedef struct {
+    char name[GFX_NAME_SIZE];
+    int width;
+    int height;
+    int levels;
+    int masked;
+    void* memory;
+    const gfx_color* texels;
+    const gfx_color* columns;
+    const gfx_color* mips[GFX_MAX_MIP_LEVELS];
+} gfx_bitmap;
+
+/* A bundle file starts with this header followed by count entries, then the texels
+ * that the entries point at. Everything is little endian. */
+typedef struct {
+    char magic[4];
+    Uint32 version;
+    Uint32 count;
+    Uint32 reserved;
+} gfx_bundle_header;
+
+typedef struct {
+    char name[GFX_NAME_SIZE];
+    Uint32 width;
+    Uint32 height;
+    Uint32 levels;
+    Uint32 flags;
+    /* From the start of the file to the row ordered texels and to the mip chain of columns. */
+    Uint64 texels;
+    Uint64 columns;
+} gfx_bundle_entry;
+
+/* The bitmap slots grow as more are needed. A slot without texels is free. */
+static gfx_bitmap* gfx_textures = NULL;
+static int gfx_texture_count = 0;
+/* Every bundle stays mapped for as long as gfx is around since bitmaps point into them. */
+static fmap_file* gfx_bundles = NULL;
+static int gfx_bundle_count = 0;
+
+/* The CPU side framebuffers that all of the drawing goes into. There are two of
+ * them so that the frame being drawn never touches the one that was last sent to
+ * the window in a single upload. */
+static SDL_Texture* gfx_screen = NULL;
+static gfx_color* gfx_framebuffers[2] = { NULL, NULL };
+static gfx_color* gfx_framebuffer = NULL;
+static gfx_color* gfx_front = NULL;
+static int gfx_width = 0;
+static int gfx_height = 0;
+/* Frames can be drawn smaller than the framebuffers to save time, in which case
+ * only the top left corner gets used and it is stretched out over the window.
+ * Each framebuffer remembers how much of it the frame in it covers. */
+static int gfx_draw_width = 0, gfx_draw_height = 0;
+static int gfx_front_width = 0, gfx_front_height = 0;
+
+int gfx_init(int width, int height) {
+    gfx_framebuffers[0] = (gfx_color*)calloc((size_t)width * (size_t)height, sizeof(gfx_color));
+    gfx_framebuffers[1] = (gfx_color*)calloc((size_t)width * (size_t)height, sizeof(gfx_color));
+    if (gfx_framebuffers[0] == NULL || gfx_framebuffers[1] == NULL) {
+        gfx_free();
+        return -1;
+    }
+    gfx_framebuffer = gfx_framebuffers[0];
+    gfx_front = gfx_framebuffers[1];
+    gfx_width = width;
+    gfx_height = height;
+    gfx_draw_width = gfx_front_width = width;
+    gfx_draw_height = gfx_front_height = height;
+
+    /* Without a renderer we can still draw into the framebuffer, there is just
+     * nowhere to show it. */
+    if (gfx_renderer != NULL) {
+        gfx_screen = SDL_CreateTexture(gfx_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (gfx_screen == NULL) {
+            gfx_free();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void gfx_free(void) {
     int i;
-    /* Find a open texture slot that we can use if there is one. */
-    for (i = 0; i < GFX_MAX_TEXTURES; i++) {
-        if (gfx_textures[i] == NULL) {
-            gfx_textures[i] = SDL_LoadBMP(fname);
+
+    /* Anything that nobody freed goes now, then the bundles they might point into. */
+    for (i = 0; i < gfx_texture_count; i++)
+        gfx_free_bitmap(i);
+    free(gfx_textures);
+    gfx_textures = NULL;
+    gfx_texture_count = 0;
+    for (i = 0; i < gfx_bundle_count; i++)
+        fmap_close(&gfx_bundles[i]);
+    free(gfx_bundles);
+    gfx_bundles = NULL;
+    gfx_bundle_count = 0;
+
+    if (gfx_screen != NULL)
+        SDL_DestroyTexture(gfx_screen);
+    free(gfx_framebuffers[0]);
+    free(gfx_framebuffers[1]);
+    gfx_screen = NULL;
+    gfx_framebuffers[0] = NULL;
+    gfx_framebuffers[1] = NULL;
+    gfx_framebuffer = NULL;
+    gfx_front = NULL;
+    gfx_width = 0;
+    gfx_height = 0;
+    gfx_draw_width = gfx_front_width = 0;
+    gfx_draw_height = gfx_front_height = 0;
+}
+
+void gfx_present(void) {
+    if (gfx_renderer != NULL && gfx_screen != NULL) {
+        /* One upload for the whole frame instead of talking to the driver for every pixel.
+         * Only the part that was drawn gets sent and then it is scaled up to fill the window. */
+        SDL_Rect drawn = { 0, 0, gfx_front_width, gfx_front_height };
+        SDL_UpdateTexture(gfx_screen, &drawn, gfx_front, gfx_width * (int)sizeof(gfx_color));
+        SDL_RenderCopy(gfx_renderer, gfx_screen, &drawn, NULL);
+    }
+}
+
+void gfx_swap(void) {
+    /* The frame that was just drawn is the one that gets presented from now on and
+     * drawing moves over to the other one. */
+    gfx_color* drawn = gfx_framebuffer;
+    int drawn_width = gfx_draw_width;
+    int drawn_height = gfx_draw_height;
+
+    gfx_framebuffer = gfx_front;
+    gfx_draw_width = gfx_front_width;
+    gfx_draw_height = gfx_front_height;
+    gfx_front = drawn;
+    gfx_front_width = drawn_width;
+    gfx_front_height = drawn_height;
+}
+
+void gfx_set_size(int width, int height) {
+    /* Sets how much of the back framebuffer the next frame is going to cover. */
+    if (width < 1)
+        width = 1;
+    if (width > gfx_width)
+        width = gfx_width;
+    if (height < 1)
+        height = 1;
+    if (height > gfx_height)
+        height = gfx_height;
+    gfx_draw_width = width;
+    gfx_draw_height = height;
+}
+
+gfx_color* gfx_get_framebuffer(int* pitch) {
+    /* The pitch is given in pixels, not bytes. */
+    if (pitch != NULL)
+        *pitch = gfx_width;
+    return gfx_framebuffer;
+}
+
+/* Every texel in a level is the average of the 2x2 texels under it in the level
+ * above, alpha included. Once one side is down to a single texel the same one just
+ * gets used twice. */
+static void gfx_generate_mip(gfx_bitmap* bitmap, int level) {
+    const gfx_color* above = bitmap->mips[level - 1];
+    /* Only ever written while the bitmap is being made, in memory that it owns. */
+    gfx_color* mip = (gfx_color*)bitmap->mips[level];
+    int above_width = GFX_MIP_SIZE(bitmap->width, level - 1);
+    int above_height = GFX_MIP_SIZE(bitmap->height, level - 1);
+    int width = GFX_MIP_SIZE(bitmap->width, level);
+    int height = GFX_MIP_SIZE(bitmap->height, level);
+    int x, y;
+
+    for (x = 0; x < width; x++) {
+        int x0 = 2 * x < above_width ? 2 * x : above_width - 1;
+        int x1 = 2 * x + 1 < above_width ? 2 * x + 1 : above_width - 1;
+
+        for (y = 0; y < height; y++) {
+            int y0 = 2 * y < above_height ? 2 * y : above_height - 1;
+            int y1 = 2 * y + 1 < above_height ? 2 * y + 1 : above_height - 1;
+            gfx_color a = above[x0 * above_height + y0];
+            gfx_color b = above[x0 * above_height + y1];
+            gfx_color c = above[x1 * above_height + y0];
+            gfx_color d = above[x1 * above_height + y1];
+
+            mip[x * height + y] = GFX_ARGB(
+                (GFX_ALPHA(a) + GFX_ALPHA(b) + GFX_ALPHA(c) + GFX_ALPHA(d) + 2) / 4,
+                (GFX_RED(a) + GFX_RED(b) + GFX_RED(c) + GFX_RED(d) + 2) / 4,
+                (GFX_GREEN(a) + GFX_GREEN(b) + GFX_GREEN(c) + GFX_GREEN(d) + 2) / 4,
+                (GFX_BLUE(a) + GFX_BLUE(b) + GFX_BLUE(c) + GFX_BLUE(d) + 2) / 4);
+        }
+    }
+}
+
+/* Finds a free bitmap slot, making more room if every one of them is in use. */
+static int gfx_new_bitmap(void) {
+    gfx_bitmap* grown;
+    int i, count;
+
+    for (i = 0; i < gfx_texture_count; i++) {
+        if (gfx_textures[i].texels == NULL)
             return i;
+    }
+    count = gfx_texture_count > 0 ? gfx_texture_count * 2 : 8;
+    grown = (gfx_bitmap*)realloc(gfx_textures, (size_t)count * sizeof(gfx_bitmap));
+    if (grown == NULL)
+        return -1;
+    memset(grown + gfx_texture_count, 0, (size_t)(count - gfx_texture_count) * sizeof(gfx_bitmap));
+    gfx_textures = grown;
+    i = gfx_texture_count;
+    gfx_texture_count = count;
+    return i;
+}
+
+/* How many levels the mip chain of a bitmap has and how many texels are in all of them. */
+static int gfx_mip_levels(int width, int height, size_t* mip_texels) {
+    int levels = 1;
+
+    *mip_texels = (size_t)width * (size_t)height;
+    /* Keep halving until the whole bitmap is one texel. */
+    while (width >> levels > 0 || height >> levels > 0) {
+        *mip_texels += (size_t)GFX_MIP_SIZE(width, levels) * (size_t)GFX_MIP_SIZE(height, levels);
+        levels++;
+    }
+    return levels;
+}
+
+static void gfx_set_mips(gfx_bitmap* bitmap) {
+    int level;
+
+    bitmap->mips[0] = bitmap->columns;
+    for (level = 1; level < bitmap->levels; level++)
+        bitmap->mips[level] = bitmap->mips[level - 1] + GFX_MIP_SIZE(bitmap->width, level - 1) * GFX_MIP_SIZE(bitmap->height, level - 1);
+}
+
+/* Wrapping the bitmap with a mask and halving it for every mip level both need
+ * the sides to be a power of two. */
+static int gfx_valid_size(int width, int height) {
+    return width > 0 && height > 0 && (width & (width - 1)) == 0 && (height & (height - 1)) == 0 &&
+        GFX_MIP_SIZE(width > height ? width : height, GFX_MAX_MIP_LEVELS - 1) <= 1;
+}
+
+int gfx_create_bitmap(int width, int height, const gfx_color* texels, int pitch) {
+    gfx_bitmap* bitmap;
+    gfx_color* row_texels;
+    gfx_color* columns;
+    size_t mip_texels;
+    int i, x, y, level, levels;
+
+    if (!gfx_valid_size(width, height))
+        return -1;
+
+    /* Find a open texture slot that we can use. */
+    i = gfx_new_bitmap();
+    if (i < 0)
+        return -1;
+    bitmap = &gfx_textures[i];
+
+    /* The texels and the whole mip chain of columns all go in one block. */
+    levels = gfx_mip_levels(width, height, &mip_texels);
+    bitmap->memory = malloc(((size_t)width * (size_t)height + mip_texels) * sizeof(gfx_color));
+    if (bitmap->memory == NULL)
+        return -1;
+    row_texels = (gfx_color*)bitmap->memory;
+    columns = row_texels + (size_t)width * (size_t)height;
+    bitmap->name[0] = '\0';
+    bitmap->width = width;
+    bitmap->height = height;
+    bitmap->levels = levels;
+    bitmap->masked = 0;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            gfx_color color = texels[y * pitch + x];
+            row_texels[y * width + x] = color;
+            columns[x * height + y] = color;
+            /* Remember if anything is see through so that it can get drawn that way. */
+            if (GFX_ALPHA(color) < 0x80)
+                bitmap->masked = 1;
+        }
+    }
+    bitmap->texels = row_texels;
+    bitmap->columns = columns;
+
+    gfx_set_mips(bitmap);
+    for (level = 1; level < bitmap->levels; level++)
+        gfx_generate_mip(bitmap, level);
+    return i;
+}
+
+int gfx_generate_bitmap(const char* fname) {
+    SDL_Surface* loaded;
+    SDL_Surface* surf;
+    const char* name;
+    int index, x, y;
+
+    loaded = SDL_LoadBMP(fname);
+    if (loaded == NULL)
+        return -1;
+    /* Let SDL deal with whatever format the file was in, after this we only
+     * ever see our own format. */
+    surf = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(loaded);
+    if (surf == NULL)
+        return -1;
+
+    SDL_LockSurface(surf);
+    for (y = 0; y < surf->h; y++) {
+        gfx_color* row = (gfx_color*)((Uint8*)surf->pixels + y * surf->pitch);
+        /* Make sure the alpha is always set so that the texels can go straight to the screen. */
+        for (x = 0; x < surf->w; x++)
+            row[x] |= 0xFF000000u;
+    }
+    index = gfx_create_bitmap(surf->w, surf->h, (const gfx_color*)surf->pixels, surf->pitch / (int)sizeof(gfx_color));
+    SDL_UnlockSurface(surf);
+    SDL_FreeSurface(surf);
+
+    /* Keep the file name so that the bitmap can be found again in a bundle. Only the
+     * name goes in and not the folder it was in, the game looks it up the same way
+     * wherever the file was packed from. */
+    if (index >= 0) {
+        name = fname;
+        for (x = 0; fname[x] != '\0'; x++) {
+            if (fname[x] == '/' || fname[x] == '\\')
+                name = fname + x + 1;
         }
+        strncpy(gfx_textures[index].name, name, GFX_NAME_SIZE - 1);
+        gfx_textures[index].name[GFX_NAME_SIZE - 1] = '\0';
     }
-    /* There is no free texture space. */
+    return index;
+}
+
+int gfx_load_bundle(const char* fname) {
+    const unsigned char* data;
+    gfx_bundle_header header;
+    fmap_file* grown;
+    fmap_file* file;
+    Uint32 i;
+    int first = -1;
+
+    grown = (fmap_file*)realloc(gfx_bundles, (size_t)(gfx_bundle_count + 1) * sizeof(fmap_file));
+    if (grown == NULL)
+        return -1;
+    gfx_bundles = grown;
+    file = &gfx_bundles[gfx_bundle_count];
+    if (fmap_open(fname, file) != 0)
+        return -1;
+    data = (const unsigned char*)file->data;
+
+    if (file->size < sizeof(gfx_bundle_header))
+        goto bad_file;
+    memcpy(&header, data, sizeof(gfx_bundle_header));
+    if (memcmp(header.magic, GFX_BUNDLE_MAGIC, 4) != 0 || header.version != GFX_BUNDLE_VERSION)
+        goto bad_file;
+    if (header.count > (file->size - sizeof(gfx_bundle_header)) / sizeof(gfx_bundle_entry))
+        goto bad_file;
+
+    /* Check every entry before any of them get used so that a bad file does not
+     * leave half of its bitmaps behind. */
+    for (i = 0; i < header.count; i++) {
+        gfx_bundle_entry entry;
+        size_t mip_texels;
+        Uint64 texels_size;
+
+        memcpy(&entry, data + sizeof(gfx_bundle_header) + i * sizeof(gfx_bundle_entry), sizeof(gfx_bundle_entry));
+        if (entry.width > 0x7FFFFFFF || entry.height > 0x7FFFFFFF || !gfx_valid_size((int)entry.width, (int)entry.height))
+            goto bad_file;
+        if ((int)entry.levels != gfx_mip_levels((int)entry.width, (int)entry.height, &mip_texels))
+            goto bad_file;
+        texels_size = (Uint64)entry.width * entry.height * sizeof(gfx_color);
+        if (entry.texels % sizeof(gfx_color) != 0 || entry.texels > file->size || texels_size > file->size - entry.texels)
+            goto bad_file;
+        if (entry.columns % sizeof(gfx_color) != 0 || entry.columns > file->size || (Uint64)mip_texels * sizeof(gfx_color) > file->size - entry.columns)
+            goto bad_file;
+    }
+
+    /* Nothing gets decoded or copied, the bitmaps use the texels right where they are
+     * in the file and only the pages that get drawn from are ever read in. */
+    for (i = 0; i < header.count; i++) {
+        gfx_bundle_entry entry;
+        gfx_bitmap* bitmap;
+        int index = gfx_new_bitmap();
+
+        if (index < 0)
+            goto no_room;
+        memcpy(&entry, data + sizeof(gfx_bundle_header) + i * sizeof(gfx_bundle_entry), sizeof(gfx_bundle_entry));
+        bitmap = &gfx_textures[index];
+        memcpy(bitmap->name, entry.name, GFX_NAME_SIZE);
+        bitmap->name[GFX_NAME_SIZE - 1] = '\0';
+        bitmap->width = (int)entry.width;
+        bitmap->height = (int)entry.height;
+        bitmap->levels = (int)entry.levels;
+        bitmap->masked = (entry.flags & GFX_BUNDLE_MASKED) != 0;
+        bitmap->memory = NULL;
+        bitmap->texels = (const gfx_color*)(data + entry.texels);
+        bitmap->columns = (const gfx_color*)(data + entry.columns);
+        gfx_set_mips(bitmap);
+        if (first < 0)
+            first = index;
+    }
+    gfx_bundle_count++;
+    return first;
+
+no_room:
+    /* Take back the bitmaps that did make it in, they all point into this bundle. */
+    for (i = 0; i < (Uint32)gfx_texture_count; i++) {
+        const unsigned char* texels = (const unsigned char*)gfx_textures[i].texels;
+        if (texels >= data && texels < data + file->size)
+            gfx_free_bitmap((int)i);
+    }
+bad_file:
+    fmap_close(file);
     return -1;
 }
 
-void gfx_free_bitmap(int index) {
-    if (index < GFX_MAX_TEXTURES && index >= 0) {
-        if (gfx_textures[index] != NULL) {
-            SDL_FreeSurface(gfx_textures[index]);
+/* Rounds an offset in a bundle up to where the next block of texels can start. */
+static Uint64 gfx_bundle_align(Uint64 offset) {
+    return (offset + GFX_BUNDLE_ALIGN - 1) / GFX_BUNDLE_ALIGN * GFX_BUNDLE_ALIGN;
+}
+
+/* Writes a block of texels at an aligned offset, padding with zeros up to it. */
+static int gfx_write_texels(FILE* file, Uint64* offset, const gfx_color* texels, size_t count) {
+    static const unsigned char padding[GFX_BUNDLE_ALIGN] = { 0 };
+    size_t pad = (size_t)(gfx_bundle_align(*offset) - *offset);
+
+    if (fwrite(padding, 1, pad, file) != pad || fwrite(texels, sizeof(gfx_color), count, file) != count)
+        return -1;
+    *offset += pad + count * sizeof(gfx_color);
+    return 0;
+}
+
+int gfx_save_bundle(const char* fname) {
+    gfx_bundle_header header;
+    Uint64 offset;
+    FILE* file;
+    int i;
+
+    /* Only bitmaps with a name can be found again so those are the ones that go in. */
+    memcpy(header.magic, GFX_BUNDLE_MAGIC, 4);
+    header.version = GFX_BUNDLE_VERSION;
+    header.count = 0;
+    header.reserved = 0;
+    for (i = 0; i < gfx_texture_count; i++) {
+        if (gfx_textures[i].texels != NULL && gfx_textures[i].name[0] != '\0')
+            header.count++;
+    }
+
+    file = fopen(fname, "wb");
+    if (file == NULL)
+        return -1;
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        goto bad_write;
+
+    /* All of the entries go first, pointing at where their texels will end up. */
+    offset = sizeof(gfx_bundle_header) + (Uint64)header.count * sizeof(gfx_bundle_entry);
+    for (i = 0; i < gfx_texture_count; i++) {
+        const gfx_bitmap* bitmap = &gfx_textures[i];
+        gfx_bundle_entry entry;
+        size_t mip_texels;
+
+        if (bitmap->texels == NULL || bitmap->name[0] == '\0')
+            continue;
+        gfx_mip_levels(bitmap->width, bitmap->height, &mip_texels);
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, bitmap->name, GFX_NAME_SIZE);
+        entry.width = (Uint32)bitmap->width;
+        entry.height = (Uint32)bitmap->height;
+        entry.levels = (Uint32)bitmap->levels;
+        entry.flags = bitmap->masked ? GFX_BUNDLE_MASKED : 0;
+        entry.texels = gfx_bundle_align(offset);
+        offset = entry.texels + (Uint64)bitmap->width * bitmap->height * sizeof(gfx_color);
+        entry.columns = gfx_bundle_align(offset);
+        offset = entry.columns + (Uint64)mip_texels * sizeof(gfx_color);
+        if (fwrite(&entry, sizeof(entry), 1, file) != 1)
+            goto bad_write;
+    }
+
+    /* Then the texels in the same order, already converted and with their mips. */
+    offset = sizeof(gfx_bundle_header) + (Uint64)header.count * sizeof(gfx_bundle_entry);
+    for (i = 0; i < gfx_texture_count; i++) {
+        const gfx_bitmap* bitmap = &gfx_textures[i];
+        size_t mip_texels;
+
+        if (bitmap->texels == NULL || bitmap->name[0] == '\0')
+            continue;
+        gfx_mip_levels(bitmap->width, bitmap->height, &mip_texels);
+        if (gfx_write_texels(file, &offset, bitmap->texels, (size_t)bitmap->width * (size_t)bitmap->height) != 0 ||
+            gfx_write_texels(file, &offset, bitmap->columns, mip_texels) != 0)
+            goto bad_write;
+    }
+    return fclose(file) == 0 ? 0 : -1;
+
+bad_write:
+    fclose(file);
+    return -1;
+}
+
+int gfx_find_bitmap(const char* name) {
+    int i;
+
+    for (i = 0; i < gfx_texture_count; i++) {
+        if (gfx_textures[i].texels != NULL && strcmp(gfx_textures[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int gfx_get_bitmap_count(void) {
+    int count = 0, i;
+
+    for (i = 0; i < gfx_texture_count; i++) {
+        if (gfx_textures[i].texels != NULL)
+            count++;
+    }
+    return count;
+}
+
+int gfx_get_bitmap_slots(void) {
+    /* Every bitmap has an index below this, though some of the slots may be free. */
+    return gfx_texture_count;
+}
+
+int gfx_get_bitmap_masked(int index) {
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            return gfx_textures[index].masked;
         }
     }
+    /* There is no texture with this index. */
+    return 0;
+}
+
+void gfx_free_bitmap(int index) {
+    if (index < gfx_texture_count && index >= 0) {
+        /* Bitmaps out of a bundle do not own their texels, the bundle does. */
+        free(gfx_textures[index].memory);
+        memset(&gfx_textures[index], 0, sizeof(gfx_bitmap));
+    }
 }
 
 int gfx_get_bitmap_width(int index) {
-    if (index < GFX_MAX_TEXTURES && index >= 0) {
-        if (gfx_textures[index] != NULL) {
-            return gfx_textures[index]->w;
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            return gfx_textures[index].width;
         }
     }
     /* There is no texture with this index. */
@@ -37,48 +566,141 @@ int gfx_get_bitmap_width(int index) {
 }
 
 int gfx_get_bitmap_height(int index) {
-    if (index < GFX_MAX_TEXTURES && index >= 0) {
-        if (gfx_textures[index] != NULL) {
-            return gfx_textures[index]->h;
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            return gfx_textures[index].height;
         }
     }
     /* There is no texture with this index. */
     return -1;
 }
 
+const gfx_color* gfx_get_bitmap_pixels(int index, int* pitch) {
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            /* The pitch is given in texels, not bytes. */
+            if (pitch != NULL)
+                *pitch = gfx_textures[index].width;
+            return gfx_textures[index].texels;
+        }
+    }
+    /* There is no texture with this index. */
+    return NULL;
+}
+
+const gfx_color* gfx_get_bitmap_column(int index, int x) {
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            /* Make sure we are not out of range. */
+            if (x < 0 || x >= gfx_textures[index].width)
+                return NULL;
+            /* The column is stored contiguously, one texel after another from top to bottom. */
+            return gfx_textures[index].columns + x * gfx_textures[index].height;
+        }
+    }
+    /* There is no texture with this index. */
+    return NULL;
+}
+
+int gfx_get_bitmap_levels(int index) {
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            return gfx_textures[index].levels;
+        }
+    }
+    /* There is no texture with this index. */
+    return -1;
+}
+
+const gfx_color* gfx_get_bitmap_mip_column(int index, int level, int x) {
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            gfx_bitmap* bitmap = &gfx_textures[index];
+
+            /* Make sure we are not out of range, remembering that the level is narrower than the bitmap. */
+            if (level < 0 || level >= bitmap->levels || x < 0 || x >= GFX_MIP_SIZE(bitmap->width, level))
+                return NULL;
+            return bitmap->mips[level] + x * GFX_MIP_SIZE(bitmap->height, level);
+        }
+    }
+    /* There is no texture with this index. */
+    return NULL;
+}
+
+const gfx_color* gfx_get_bitmap_mip(int index, int level) {
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            if (level < 0 || level >= gfx_textures[index].levels)
+                return NULL;
+            /* The whole level, one column after another, for when texels get read from all over it. */
+            return gfx_textures[index].mips[level];
+        }
+    }
+    /* There is no texture with this index. */
+    return NULL;
+}
+
 void gfx_get_bitmap_color(int index, int x, int y, int* r, int* g, int* b) {
-    SDL_Surface* surf;
-    int bpp;
-    Uint8* pixel;
-    Uint32 color;
-    Uint8 red, green, blue;
+    gfx_bitmap* bitmap;
+    gfx_color color;
 
-    if (index < GFX_MAX_TEXTURES && index >= 0) {
-        if (gfx_textures[index] != NULL) {
-            surf = gfx_textures[index];
-            bpp = surf->format->BytesPerPixel;
+    if (index < gfx_texture_count && index >= 0) {
+        if (gfx_textures[index].texels != NULL) {
+            bitmap = &gfx_textures[index];
 
             /* Make sure we are not out of range. */
-            if (x < 0 || y < 0 || x >= surf->w || y >= surf->h)
+            if (x < 0 || y < 0 || x >= bitmap->width || y >= bitmap->height)
                 return;
 
-            pixel = (Uint8*)surf->pixels + (y * surf->pitch) + (x * bpp);
-            color = *(Uint32*)pixel;
-
-            /* Convert from the surface pixel format to the raw byte values. */
-            SDL_GetRGB(color, surf->format, &red, &green, &blue);
-            /* Now when we have everything we can set the outputs. */
-            *r = red;
-            *g = green;
-            *b = blue;
+            color = bitmap->texels[y * bitmap->width + x];
+            *r = GFX_RED(color);
+            *g = GFX_GREEN(color);
+            *b = GFX_BLUE(color);
         }
     }
     /* There is no texture with this index so do nothing. */
 }
 
 void gfx_putpixel(int x, int y, int r, int g, int b) {
-    if (gfx_renderer != NULL) {
-        SDL_SetRenderDrawColor(gfx_renderer, r, g, b, 255);
-        SDL_RenderDrawPoint(gfx_renderer, x, y);
+    if (x < 0 || y < 0 || x >= gfx_width || y >= gfx_height)
+        return;
+    gfx_framebuffer[y * gfx_width + x] = GFX_RGB(r, g, b);
+}
+
+void gfx_putcolumn(int x, int y, int count, const gfx_color* colors) {
+    gfx_color* pixel;
+    int i;
+
+    /* Clip the column against the framebuffer. */
+    if (x < 0 || x >= gfx_width)
+        return;
+    if (y < 0) {
+        colors -= y;
+        count += y;
+        y = 0;
+    }
+    if (y + count > gfx_height)
+        count = gfx_height - y;
+
+    pixel = gfx_framebuffer + y * gfx_width + x;
+    for (i = 0; i < count; i++) {
+        *pixel = colors[i];
+        pixel += gfx_width;
     }
+}
+
+void gfx_putspan(int x, int y, int count, const gfx_color* colors) {
+    /* Clip the span against the framebuffer. */
+    if (y < 0 || y >= gfx_height)
+        return;
+    if (x < 0) {
+        colors -= x;
+        count += x;
+        x = 0;
+    }
+    if (x + count > gfx_width)
+        count = gfx_width - x;
+
+    if (count > 0)
+        memcpy(gfx_framebuffer + y * gfx_width + x, colors, count * sizeof(gfx_color));
 }
\ No newline at end of file
@@ -1,17 +1,192 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <SDL.h>
+#include "bench.h"
+#include "capture.h"
+#include "check.h"
 #include "demo.h"
+#include "gfx.h"
+#include "map.h"
+#include "probe.h"
+#include "prof.h"
+#include "ray.h"
+#include "res.h"
+#include "sim.h"
 
 #define FPS                             (60.0f)
-#define MIN_FPS                         (20.0f)
 #define MIN_FRAME_TIME                  (1.0f/FPS)
-#define MAX_FRAME_TIME                  (1.0f/MIN_FPS)
+/* Frames get started this much earlier than how long they have been taking to draw,
+ * to cover how coarse sleeping is and the odd frame that runs over. */
+#define RENDER_MARGIN                   (0.002f)
+/* How much of the way the draw time estimate comes back down each frame after a slow one. */
+#define RENDER_ESTIMATE_DECAY           (0.05f)
+/* The main thread hands the keys over this long before the render thread picks them up. */
+#define RENDER_EVENT_LEAD               (0.001f)
 
 extern SDL_Renderer* gfx_renderer;
 
+/* Frames get drawn on their own thread into the back framebuffer while the main
+ * thread is busy sending the front one to the window. The main thread lets it
+ * start on a frame once the buffer is free and it says when the frame is done.
+ * It holds off on picking up the keys until it only just has time to draw the
+ * frame before it is due to be presented, so they are as fresh as they can be. */
+static SDL_Thread* render_thread = NULL;
+static SDL_sem* render_go = NULL;
+static SDL_sem* render_drawn = NULL;
+static SDL_atomic_t render_quit;
+/* When the render thread picks up the keys for the frame it was let go on. Only the
+ * main thread sets it and only before it lets the render thread go. */
+static Uint64 render_latch_at = 0;
+/* How long frames have been taking from picking up the keys to being done, in seconds.
+ * Only the render thread sets it and only before it says the frame is done. */
+static float render_estimate = 0.0f;
+/* Whether the resolution follows how long the frames take to draw. */
+static int render_dynamic = 1;
+/* Which key changes the frame that was just drawn had seen and when it picked them up,
+ * for the latency probe. */
+static int render_input = 0;
+static Uint64 render_input_time = 0;
+/* Where the frames are being recorded to, if anywhere. */
+static const char* capture_fname = NULL;
+/* Where the timing zones get written on the way out, if anywhere. */
+static const char* trace_fname = NULL;
+
+/* Hands the frame that was just drawn to the recording, which takes a copy of it. */
+static void render_capture(void) {
+    int pitch;
+    const gfx_color* pixels = gfx_get_framebuffer(&pitch);
+
+    capture_frame(pixels, pitch, demo_get_width(), demo_get_height());
+}
+
+static void finish_capture(void) {
+    if (capture_fname == NULL)
+        return;
+    if (capture_stop() != 0)
+        fprintf(stderr, "Failed to write the capture to %s.\n", capture_fname);
+    printf("Captured %d frames to %s, %d dropped.\n", capture_get_written(), capture_fname, capture_get_dropped());
+    capture_fname = NULL;
+}
+
+/* Sleeps until the performance counter gets to the given time, if it has not already.
+ * Sleeping only goes by whole milliseconds so it can wake up to one early. */
+static void sleep_until(Uint64 when) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint32 ms;
+
+    if (when <= now)
+        return;
+    ms = (Uint32)((when - now) * 1000 / SDL_GetPerformanceFrequency());
+    if (ms > 0)
+        SDL_Delay(ms);
+}
+
+/* Turns a number of seconds into performance counter ticks. */
+static Uint64 seconds_to_ticks(float seconds) {
+    return (Uint64)(seconds * (float)SDL_GetPerformanceFrequency());
+}
+
+static int render_run(void* data) {
+    (void)data;
+    PROF_THREAD("render");
+
+    for (;;) {
+        ray_camera camera;
+        Uint64 latched;
+        float took;
+
+        SDL_SemWait(render_go);
+        if (SDL_AtomicGet(&render_quit))
+            break;
+
+        /* Pick up the keys as late as we can, right before the frame has to be drawn. */
+        {
+            PROF_BEGIN(hold);
+            sleep_until(render_latch_at);
+            PROF_END(hold, "hold for keys");
+        }
+        render_input = probe_latch(&render_input_time);
+        latched = SDL_GetPerformanceCounter();
+        sim_get_camera(&camera);
+        if (render_dynamic)
+            demo_set_resolution(res_get_width(), res_get_height());
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            demo_draw_camera(&camera);
+            PROF_END(start, "demo_draw");
+            /* See if the next frame needs to be drawn at a different size to stay on time. */
+            if (render_dynamic)
+                res_update((float)(SDL_GetPerformanceCounter() - start) / (float)SDL_GetPerformanceFrequency());
+        }
+        /* Recording only takes a copy and is left out of the time the resolution goes by. */
+        render_capture();
+        /* A slow frame pushes the estimate straight up but it only comes back down slowly,
+         * so a frame that runs over once does not get presented late over and over. */
+        took = (float)(SDL_GetPerformanceCounter() - latched) / (float)SDL_GetPerformanceFrequency();
+        if (took > render_estimate)
+            render_estimate = took;
+        else
+            render_estimate += (took - render_estimate) * RENDER_ESTIMATE_DECAY;
+        SDL_SemPost(render_drawn);
+    }
+    return 0;
+}
+
+static int render_start(void) {
+    SDL_AtomicSet(&render_quit, 0);
+    render_go = SDL_CreateSemaphore(0);
+    render_drawn = SDL_CreateSemaphore(0);
+    if (render_go == NULL || render_drawn == NULL)
+        return -1;
+    render_thread = SDL_CreateThread(render_run, "render", NULL);
+    return render_thread != NULL ? 0 : -1;
+}
+
+/* Lets the render thread start on the next frame, which is due to be presented at the
+ * given time. It works out from how long frames have been taking when to pick up the keys. */
+static void render_begin(Uint64 present_at) {
+    Uint64 lead = seconds_to_ticks(render_estimate + RENDER_MARGIN);
+
+    render_latch_at = present_at > lead ? present_at - lead : 0;
+    SDL_SemPost(render_go);
+}
+
+static void render_stop(void) {
+    /* The render thread always finishes the frame it is on before it looks again. */
+    if (render_thread != NULL) {
+        SDL_AtomicSet(&render_quit, 1);
+        SDL_SemPost(render_go);
+        SDL_WaitThread(render_thread, NULL);
+        render_thread = NULL;
+    }
+    if (render_go != NULL)
+        SDL_DestroySemaphore(render_go);
+    if (render_drawn != NULL)
+        SDL_DestroySemaphore(render_drawn);
+    render_go = NULL;
+    render_drawn = NULL;
+}
+
+/* Keeps track of a key and lets the latency probe know when one actually changes. */
+static void set_key(int* keys, int key, int down) {
+    if (keys[key] != down)
+        probe_input();
+    keys[key] = down;
+}
+
 static void cleanup(SDL_Window* window, SDL_Renderer* renderer) {
+    /* Nothing else can be drawing or ticking once the demo goes away. */
+    render_stop();
+    finish_capture();
+    sim_stop();
     demo_free();
+    gfx_free();
+    /* Every thread that records zones has been joined by now so nothing is still
+     * writing into the buffers while they get dumped. */
+    if (trace_fname != NULL)
+        PROF_DUMP(trace_fname);
+    PROF_FREE();
 
     /* We need to check if a resources exists because if there
      * was a fatal error than we might be cleaning up before the
@@ -44,8 +219,165 @@ int main(int argc, char* argv[]) {
     Uint64 start_time = 0;
     Uint64 end_time = 0;
     Uint64 timer_freq = 0;
+    /* When the frame that is being drawn is due to be presented. */
+    Uint64 present_at = 0;
     /* Keep track of user input. */
-    int keys[4] = { 0 };
+    int keys[DEMO_INPUTS] = { 0 };
+    /* Command line options. */
+    demo_config config = { 0, RAY_ISA_AUTO, NULL, 0, NULL, 0.0f, DEMO_DEFAULT_SPRITES, DEMO_WIDTH, DEMO_HEIGHT, 0 };
+    bench_config bench = { 0, NULL, NULL, 1 };
+    const char* save_map = NULL;
+    const char* pack = NULL;
+    const char* capture = NULL;
+    int latency = 0;
+    int check = 0;
+    int presented;
+    Uint64 presented_latch;
+    int pack_first = 0, pack_count = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        /* How many threads to draw with, the default is one for each core. */
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            config.workers = atoi(argv[++i]);
+        /* Force the ray casting onto a particular instruction set, the default is the best one we have. */
+        if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "scalar") == 0)
+                config.isa = RAY_ISA_SCALAR;
+            else if (strcmp(argv[i], "sse2") == 0)
+                config.isa = RAY_ISA_SSE2;
+            else if (strcmp(argv[i], "avx2") == 0)
+                config.isa = RAY_ISA_AVX2;
+        }
+        /* Load the level from a map file, or make a random square one of the given size. */
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+            config.map = argv[++i];
+        if (strcmp(argv[i], "--map-random") == 0 && i + 1 < argc)
+            config.map_size = atoi(argv[++i]);
+        /* How many blocks away things fade out to black. */
+        if (strcmp(argv[i], "--max-light") == 0 && i + 1 < argc)
+            config.max_light = (float)atof(argv[++i]);
+        /* How many sprites to put in the level. */
+        if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc)
+            config.sprites = atoi(argv[++i]);
+        /* The largest resolution to draw at, like 640x480. */
+        if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            int width, height;
+            if (sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+                config.width = width;
+                config.height = height;
+            }
+        }
+        /* Start out drawing with the fixed point renderer, F switches between them. */
+        if (strcmp(argv[i], "--fixed-point") == 0)
+            config.fixed_point = 1;
+        /* Always draw at the full resolution instead of dropping it to keep up. */
+        if (strcmp(argv[i], "--fixed-resolution") == 0)
+            render_dynamic = 0;
+        /* Load all of the bitmaps from a bundle made with --pack. */
+        if (strcmp(argv[i], "--bundle") == 0 && i + 1 < argc)
+            config.bundle = argv[++i];
+        /* Bake bitmaps into a bundle and quit, every file after it up to the next option goes in. */
+        if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            pack = argv[++i];
+            pack_first = i + 1;
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                pack_count++;
+                i++;
+            }
+        }
+        /* Write out whatever map we ended up with so that it can be loaded later. */
+        if (strcmp(argv[i], "--save-map") == 0 && i + 1 < argc)
+            save_map = argv[++i];
+        /* Run a benchmark without a window, optionally with how many frames to draw. */
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench.frames = BENCH_DEFAULT_FRAMES;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                bench.frames = atoi(argv[++i]);
+        }
+        if (strcmp(argv[i], "--bench-script") == 0 && i + 1 < argc)
+            bench.script = argv[++i];
+        if (strcmp(argv[i], "--bench-json") == 0 && i + 1 < argc)
+            bench.json = argv[++i];
+        /* Draw this many cameras every frame of the benchmark instead of just the one. */
+        if (strcmp(argv[i], "--bench-views") == 0 && i + 1 < argc)
+            bench.views = atoi(argv[++i]);
+        /* Make sure the parts that have to agree with each other still do, then quit. */
+        if (strcmp(argv[i], "--check") == 0)
+            check = 1;
+        /* Record every frame that gets drawn, as Y4M if the name ends in .y4m or as PPMs otherwise. */
+        if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capture = argv[++i];
+        /* Measure how long key presses take to reach the screen and say so on exit. */
+        if (strcmp(argv[i], "--latency") == 0)
+            latency = 1;
+        /* Where to write the timing zones on exit, only does anything when built with PROF_ENABLED. */
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_fname = argv[++i];
+    }
+
+    /* Packing is done ahead of time so the game never has to decode a bitmap. Without
+     * any files it packs the bitmaps that the game uses, in the order it uses them. */
+    if (pack != NULL) {
+        static const char* defaults[] = { "steel.bmp", "bricks.bmp" };
+        const char** files = pack_count > 0 ? (const char**)argv + pack_first : defaults;
+        int count = pack_count > 0 ? pack_count : (int)(sizeof(defaults) / sizeof(defaults[0]));
+        int result = 0;
+
+        for (i = 0; i < count; i++) {
+            if (gfx_generate_bitmap(files[i]) < 0) {
+                fprintf(stderr, "Failed to load %s.\n", files[i]);
+                result = 1;
+            }
+        }
+        if (result == 0 && gfx_save_bundle(pack) != 0) {
+            fprintf(stderr, "Failed to write the bundle to %s.\n", pack);
+            result = 1;
+        }
+        gfx_free();
+        return result;
+    }
+
+    /* The checks make up their own maps and bitmaps, so nothing gets loaded for them. */
+    if (check)
+        return check_run();
+
+    /* The benchmark never opens a window or a renderer. Everything gets drawn into
+     * the framebuffer the same as always but it never gets shown anywhere. */
+    if (bench.frames > 0) {
+        int result;
+
+        if (SDL_Init(SDL_INIT_TIMER) != 0) {
+            fprintf(stderr, "Failed to setup SDL2.\n");
+            return 1;
+        }
+        if (gfx_init(config.width, config.height) != 0) {
+            fprintf(stderr, "Failed to create the framebuffer.\n");
+            cleanup(NULL, NULL);
+            return 1;
+        }
+        PROF_THREAD("main");
+        if (demo_init(&config) != 0) {
+            fprintf(stderr, "Failed to load the map or bitmaps.\n");
+            cleanup(NULL, NULL);
+            return 1;
+        }
+        if (save_map != NULL && map_save(save_map) != 0)
+            fprintf(stderr, "Failed to save the map to %s.\n", save_map);
+        if (capture != NULL) {
+            if (capture_start(capture, config.width, config.height, (int)(1.0f / BENCH_DELTA_TIME + 0.5f)) != 0) {
+                fprintf(stderr, "Failed to start capturing to %s.\n", capture);
+                cleanup(NULL, NULL);
+                return 1;
+            }
+            capture_fname = capture;
+        }
+        result = bench_run(&bench);
+        finish_capture();
+        cleanup(NULL, NULL);
+        return result;
+    }
 
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0)
         fatal_error("Failed to setup SDL2.", window, renderer);
@@ -73,104 +405,173 @@ int main(int argc, char* argv[]) {
     /* Set a virtual resolution on the renderer since this is supposed to work
      * in the same way that the old orginal 3D raycasting engines did which
      * means we need a low resolution screen. */
-    SDL_RenderSetLogicalSize(renderer, DEMO_WIDTH, DEMO_HEIGHT);
+    SDL_RenderSetLogicalSize(renderer, config.width, config.height);
     gfx_renderer = renderer;
+    /* Everything gets drawn into a framebuffer at the virtual resolution first. When
+     * frames are drawn smaller than that they get scaled back up to it. */
+    if (gfx_init(config.width, config.height) != 0)
+        fatal_error("Failed to create the framebuffer.", window, renderer);
 
-    demo_init();
+    PROF_THREAD("main");
+    if (demo_init(&config) != 0)
+        fatal_error("Failed to load the map or bitmaps.", window, renderer);
+    if (save_map != NULL && map_save(save_map) != 0)
+        fatal_error("Failed to save the map.", window, renderer);
+    if (capture != NULL) {
+        if (capture_start(capture, config.width, config.height, SIM_TICK_RATE) != 0)
+            fatal_error("Failed to start capturing.", window, renderer);
+        capture_fname = capture;
+    }
+
+    /* Drawing gets the whole frame time to itself since presenting happens alongside it. */
+    res_init(config.width, config.height, MIN_FRAME_TIME);
+
+    /* The simulation ticks along on its own thread and the frames get drawn on another. */
+    if (sim_start() != 0 || render_start() != 0)
+        fatal_error("Failed to start the simulation and render threads.", window, renderer);
 
     /* Figure out of how often the high performance hardware timer ticks per second so that
      * we can accuratly control our game loop. */
     timer_freq = SDL_GetPerformanceFrequency();
     start_time = SDL_GetPerformanceCounter();
+    present_at = start_time + seconds_to_ticks(MIN_FRAME_TIME);
+    render_begin(present_at);
 
     /* Run the main game loop. This loop will try to maintain a constant frame
-     * rate by sleeping the extra milliseconds. Each frame, we will calculate how
-     * long the last frame took and if we did not take as long as budgeted, then
-     * we will sleep and give that time back to the operating system. This will allow
-     * something else to run instead of spare the user's battery. */
+     * rate by sleeping the extra milliseconds. Each frame, we will sleep until just
+     * before the render thread picks up the keys and give that time back to the
+     * operating system. This will allow something else to run instead of spare the
+     * user's battery. */
     while (!done) {
-        if (SDL_PollEvent(&sdl_event)) {
-            switch (sdl_event.type) {
-            case SDL_QUIT:
-                done = 1;
-                break;
-            case SDL_KEYDOWN:
-                /* Handle the different keyboard keys that we are dealing with. */
-                if (sdl_event.key.keysym.sym == SDLK_ESCAPE)
+        /* Sleep until the keys are about to be picked up for the frame being drawn,
+         * so that the events are as fresh as they can be. */
+        {
+            Uint64 lead = seconds_to_ticks(RENDER_EVENT_LEAD);
+            PROF_BEGIN(sleep);
+            sleep_until(render_latch_at > lead ? render_latch_at - lead : 0);
+            PROF_END(sleep, "sleep");
+        }
+        /* How long did the previous frame take? */
+        end_time = SDL_GetPerformanceCounter();
+        delta_time = (float)(end_time - start_time) / (float)timer_freq;
+
+        /* Handy formula I learned from the book Programming 2D Games by Charles Kelly that
+         * gives the average frame rate. Not an exact real time number but works well because
+         * it is not so jumpy as the real number and gives a better overall idea of how fast
+         * the game is running. */
+        if (delta_time > 0.0f)
+            average_fps = (average_fps * 0.99f) + (0.01f / delta_time);
+        start_time = end_time;
+
+        /* Handle every event that is waiting before the next frame, otherwise a burst of
+         * them would hold the frame up by a whole trip around the loop each. */
+        {
+            PROF_BEGIN(events);
+            while (SDL_PollEvent(&sdl_event)) {
+                switch (sdl_event.type) {
+                case SDL_QUIT:
                     done = 1;
-                if (sdl_event.key.keysym.sym == SDLK_UP)
-                    keys[DEMO_INPUT_UP] = 1;
-                if (sdl_event.key.keysym.sym == SDLK_DOWN)
-                    keys[DEMO_INPUT_DOWN] = 1;
-                if (sdl_event.key.keysym.sym == SDLK_LEFT)
-                    keys[DEMO_INPUT_LEFT] = 1;
-                if (sdl_event.key.keysym.sym == SDLK_RIGHT)
-                    keys[DEMO_INPUT_RIGHT] = 1;
-                break;
-            case SDL_KEYUP:
-                /* Keep track of which keys are no longer held. */
-                if (sdl_event.key.keysym.sym == SDLK_UP)
-                    keys[DEMO_INPUT_UP] = 0;
-                if (sdl_event.key.keysym.sym == SDLK_DOWN)
-                    keys[DEMO_INPUT_DOWN] = 0;
-                if (sdl_event.key.keysym.sym == SDLK_LEFT)
-                    keys[DEMO_INPUT_LEFT] = 0;
-                if (sdl_event.key.keysym.sym == SDLK_RIGHT)
-                    keys[DEMO_INPUT_RIGHT] = 0;
-                break;
-            case SDL_WINDOWEVENT:
-                /* If the window looses focus then we will clear any user input as we have no
-                 * way of keeping track of what happens to the state of a key when the window
-                 * does not have focus. So we just assume that the key was released. The user
-                 * just press again to keep moving. */
-                if (sdl_event.window.type == SDL_WINDOWEVENT_FOCUS_LOST) {
-                    keys[DEMO_INPUT_UP] = 0;
-                    keys[DEMO_INPUT_DOWN] = 0;
-                    keys[DEMO_INPUT_LEFT] = 0;
-                    keys[DEMO_INPUT_RIGHT] = 0;
+                    break;
+                case SDL_KEYDOWN:
+                    /* Handle the different keyboard keys that we are dealing with. */
+                    if (sdl_event.key.keysym.sym == SDLK_ESCAPE)
+                        done = 1;
+                    if (sdl_event.key.keysym.sym == SDLK_UP)
+                        set_key(keys, DEMO_INPUT_UP, 1);
+                    if (sdl_event.key.keysym.sym == SDLK_DOWN)
+                        set_key(keys, DEMO_INPUT_DOWN, 1);
+                    if (sdl_event.key.keysym.sym == SDLK_LEFT)
+                        set_key(keys, DEMO_INPUT_LEFT, 1);
+                    if (sdl_event.key.keysym.sym == SDLK_RIGHT)
+                        set_key(keys, DEMO_INPUT_RIGHT, 1);
+                    if (sdl_event.key.keysym.sym == SDLK_SPACE)
+                        set_key(keys, DEMO_INPUT_USE, 1);
+                    /* Switch between the float and fixed point renderers. Holding the key
+                     * down repeats it, only the first press counts. */
+                    if (sdl_event.key.keysym.sym == SDLK_f && !sdl_event.key.repeat)
+                        demo_set_fixed_point(!demo_get_fixed_point());
+                    break;
+                case SDL_KEYUP:
+                    /* Keep track of which keys are no longer held. */
+                    if (sdl_event.key.keysym.sym == SDLK_UP)
+                        set_key(keys, DEMO_INPUT_UP, 0);
+                    if (sdl_event.key.keysym.sym == SDLK_DOWN)
+                        set_key(keys, DEMO_INPUT_DOWN, 0);
+                    if (sdl_event.key.keysym.sym == SDLK_LEFT)
+                        set_key(keys, DEMO_INPUT_LEFT, 0);
+                    if (sdl_event.key.keysym.sym == SDLK_RIGHT)
+                        set_key(keys, DEMO_INPUT_RIGHT, 0);
+                    if (sdl_event.key.keysym.sym == SDLK_SPACE)
+                        set_key(keys, DEMO_INPUT_USE, 0);
+                    break;
+                case SDL_WINDOWEVENT:
+                    /* If the window looses focus then we will clear any user input as we have no
+                     * way of keeping track of what happens to the state of a key when the window
+                     * does not have focus. So we just assume that the key was released. The user
+                     * just press again to keep moving. */
+                    if (sdl_event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                        set_key(keys, DEMO_INPUT_UP, 0);
+                        set_key(keys, DEMO_INPUT_DOWN, 0);
+                        set_key(keys, DEMO_INPUT_LEFT, 0);
+                        set_key(keys, DEMO_INPUT_RIGHT, 0);
+                        set_key(keys, DEMO_INPUT_USE, 0);
+                    }
+                /* We don't handle this event type so ignore it. */
+                default:
+                    break;
                 }
-            /* We don't handle this event type so ignore it. */
-            default:
-                break;
             }
-        } else {
-            /* How long did the previous frame take? */
-            end_time = SDL_GetPerformanceCounter();
-            delta_time = (float)(end_time - start_time) / (float)timer_freq;
-            /* Check to see if we have extra time left over that we can let the
-             * CPU sit idle or work on something else during */
-            if (delta_time < MIN_FRAME_TIME) {
-                /* Figure out how many milliseconds we can sleep. */
-                int sleepTime = (int)((MIN_FRAME_TIME - delta_time) * 1000);
-                SDL_Delay(sleepTime);
-            }
-
-            /* Handy formula I learned from the book Programming 2D Games by Charles Kelly that
-             * gives the average frame rate. Not an exact real time number but works well because
-             * it is not so jumpy as the real number and gives a better overall idea of how fast
-             * the game is running. */
-            if (delta_time > 0.0f)
-                average_fps = (average_fps * 0.99f) + (0.01f / delta_time);
-            /* If the game is running really really slow, it is usually better to just stop trying to
-             * run in real time. This is because at really low frame rates, the player will end up
-             * moving longer distances between each frame which results in very choppy movements for
-             * the player. */
-            if (delta_time > MAX_FRAME_TIME)
-                delta_time = MAX_FRAME_TIME;
-            start_time = end_time;
-
-            demo_tick(delta_time, keys);
+            /* The renderer picks the keys up right before it starts on a frame and the
+             * simulation on its next step. */
+            sim_set_keys(keys);
+            probe_publish();
+            PROF_END(events, "events");
+        }
+        if (done)
+            break;
 
-            /* Always clear to black. */
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderClear(renderer);
+        /* Wait for the render thread to finish the frame it is on and then swap it
+         * to the front. It starts on the next frame in the other buffer straight
+         * away while we send this one to the window, though it waits to pick up
+         * the keys until it only just has time to draw it. A slow frame only means
+         * fewer frames since the simulation keeps its own time. */
+        {
+            PROF_BEGIN(wait);
+            SDL_SemWait(render_drawn);
+            PROF_END(wait, "wait for render");
+        }
+        presented = render_input;
+        presented_latch = render_input_time;
+        gfx_swap();
+        /* The render thread is waiting to be let go on the next frame, so this is the one
+         * time that nothing is drawing and the map can change. */
+        sim_apply_edits();
+        /* The next frame is due one frame after this one, unless this one was so late
+         * that it is already past that. */
+        present_at += seconds_to_ticks(MIN_FRAME_TIME);
+        if (present_at < SDL_GetPerformanceCounter())
+            present_at = SDL_GetPerformanceCounter() + seconds_to_ticks(MIN_FRAME_TIME);
+        render_begin(present_at);
 
-            demo_draw();
+        /* Always clear to black. */
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
 
+        {
+            PROF_BEGIN(upload);
+            gfx_present();
+            PROF_END(upload, "upload");
+        }
+        {
+            PROF_BEGIN(present);
             SDL_RenderPresent(renderer);
+            PROF_END(present, "SDL_RenderPresent");
         }
+        probe_present(presented, presented_latch);
     }
 
+    if (latency)
+        probe_report();
     cleanup(window, renderer);
     return 0;
 }
\ No newline at end of file
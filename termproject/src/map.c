@@ -0,0 +1,439 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "fmap.h"
+#include "map.h"
+
+#define MAP_MAGIC                       ("TMAP")
+#define MAP_VERSION                     (2)
+/* Version 1 maps only have the cells. */
+#define MAP_VERSION_CELLS               (1)
+/* The cells, the floors and the ceilings, one after the other. */
+#define MAP_PLANES                      (3)
+
+/* The header at the front of a map file. The tiles of the cells come straight
+ * after it, then the tiles of the floors and the ceilings, followed by
+ * MAP_PADDING zero bytes. Everything is little endian. */
+typedef struct {
+    char magic[4];
+    Uint32 version;
+    Uint32 width;
+    Uint32 height;
+    Uint32 tile_shift;
+    float spawn_x;
+    float spawn_y;
+    Uint32 reserved;
+} map_header;
+
+static map_data map_current = { NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0.0f, 0.0f };
+/* The cells either come straight out of a mapped file or from memory that we own.
+ * Memory that we own always has all of the planes. */
+static fmap_file map_file = { NULL, 0, NULL, NULL };
+static unsigned char* map_owned = NULL;
+static unsigned char* map_distance = NULL;
+/* The box that a single changed cell needs worked out again is never any bigger
+ * than this, so changing cells one at a time never has to allocate. */
+#define MAP_UPDATE_SIZE                 (4 * MAP_DISTANCE_MAX + 1)
+static unsigned char map_update_scratch[MAP_UPDATE_SIZE * MAP_UPDATE_SIZE];
+
+/* A change to a cell that is waiting to be applied. */
+typedef struct {
+    int x, y;
+    int value;
+} map_edit;
+
+/* The queued changes go around a ring. Only one thread ever queues them and only one
+ * applies them, so each side only moves its own end along. */
+static map_edit map_edits[MAP_MAX_EDITS];
+static SDL_atomic_t map_edit_head;
+static SDL_atomic_t map_edit_tail;
+
+static size_t map_cells_size(int tiles_x, int tiles_y) {
+    return (size_t)tiles_x * (size_t)tiles_y * MAP_TILE_SIZE * MAP_TILE_SIZE;
+}
+
+/* Works out the distance field for every cell in the box from x0, y0 up to but not
+ * including x1, y1 and writes it back for the cells inside of the smaller box from
+ * wx0, wy0 to wx1, wy1. Only solid cells inside the big box are seen so it has to
+ * reach MAP_DISTANCE_MAX cells past the small one on every side that it can. The
+ * work is done in dist, which has to have room for the whole big box. */
+static void map_distance_region(unsigned char* dist, int x0, int y0, int x1, int y1, int wx0, int wy0, int wx1, int wy1) {
+    int w = x1 - x0;
+    int h = y1 - y0;
+    int x, y;
+
+    /* Start out with solid cells at 0 and the rest as far away as the edge of the map. */
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            int mx = x0 + x;
+            int my = y0 + y;
+            int d = MAP_DISTANCE_MAX;
+
+            if (map_current.cells[MAP_INDEX(map_current.tiles_x, mx, my)] > 0)
+                d = 0;
+            if (mx + 1 < d)
+                d = mx + 1;
+            if (my + 1 < d)
+                d = my + 1;
+            if (map_current.width - mx < d)
+                d = map_current.width - mx;
+            if (map_current.height - my < d)
+                d = map_current.height - my;
+            dist[y * w + x] = (unsigned char)d;
+        }
+    }
+
+    /* Two passes over the box, one forwards and one backwards, looking at the
+     * neighbours that have already been done on each pass. With diagonal steps
+     * counting as one this gives the exact distance. */
+#define MAP_NEAREST(nx, ny)             if ((nx) >= 0 && (nx) < w && (ny) >= 0 && (ny) < h && dist[(ny) * w + (nx)] + 1 < d) \
+                                            d = dist[(ny) * w + (nx)] + 1
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            int d = dist[y * w + x];
+            MAP_NEAREST(x - 1, y);
+            MAP_NEAREST(x - 1, y - 1);
+            MAP_NEAREST(x, y - 1);
+            MAP_NEAREST(x + 1, y - 1);
+            dist[y * w + x] = (unsigned char)d;
+        }
+    }
+    for (y = h - 1; y >= 0; y--) {
+        for (x = w - 1; x >= 0; x--) {
+            int d = dist[y * w + x];
+            MAP_NEAREST(x + 1, y);
+            MAP_NEAREST(x + 1, y + 1);
+            MAP_NEAREST(x, y + 1);
+            MAP_NEAREST(x - 1, y + 1);
+            dist[y * w + x] = (unsigned char)d;
+        }
+    }
+#undef MAP_NEAREST
+
+    for (y = wy0; y < wy1; y++) {
+        for (x = wx0; x < wx1; x++)
+            map_distance[MAP_INDEX(map_current.tiles_x, x, y)] = dist[(y - y0) * w + (x - x0)];
+    }
+}
+
+/* Only the cells close enough to see the one that changed can have a different
+ * distance so only those get worked out again. */
+static void map_update_distance(int x, int y) {
+    int r = MAP_DISTANCE_MAX;
+    int wx0 = x - r > 0 ? x - r : 0;
+    int wy0 = y - r > 0 ? y - r : 0;
+    int wx1 = x + r + 1 < map_current.width ? x + r + 1 : map_current.width;
+    int wy1 = y + r + 1 < map_current.height ? y + r + 1 : map_current.height;
+    int x0 = wx0 - r > 0 ? wx0 - r : 0;
+    int y0 = wy0 - r > 0 ? wy0 - r : 0;
+    int x1 = wx1 + r < map_current.width ? wx1 + r : map_current.width;
+    int y1 = wy1 + r < map_current.height ? wy1 + r : map_current.height;
+
+    map_distance_region(map_update_scratch, x0, y0, x1, y1, wx0, wy0, wx1, wy1);
+}
+
+int map_build_distance(void) {
+    unsigned char* dist;
+
+    if (map_current.cells == NULL)
+        return -1;
+
+    /* The distance field gets read with the same vector loads as the cells so it
+     * needs the same padding. */
+    if (map_distance == NULL) {
+        map_distance = (unsigned char*)calloc(map_cells_size(map_current.tiles_x, map_current.tiles_y) + MAP_PADDING, 1);
+        if (map_distance == NULL)
+            return -1;
+    }
+    dist = (unsigned char*)malloc((size_t)map_current.width * (size_t)map_current.height);
+    if (dist == NULL)
+        return -1;
+    map_distance_region(dist, 0, 0, map_current.width, map_current.height, 0, 0, map_current.width, map_current.height);
+    free(dist);
+    map_current.distance = map_distance;
+    return 0;
+}
+
+/* A map that came from a file is read only so take a copy of it before anything can
+ * change it. Old maps get plain floors and ceilings to go with their cells. The file
+ * gets unmapped straight away, which is only safe because it happens while the map
+ * is being loaded and nothing else is reading it yet. */
+static int map_make_owned(void) {
+    size_t size = map_cells_size(map_current.tiles_x, map_current.tiles_y);
+
+    if (map_owned != NULL)
+        return 0;
+    map_owned = (unsigned char*)calloc(MAP_PLANES * size + MAP_PADDING, 1);
+    if (map_owned == NULL)
+        return -1;
+    memcpy(map_owned, map_current.cells, size);
+    if (map_current.floors != NULL)
+        memcpy(map_owned + size, map_current.floors, size);
+    if (map_current.ceilings != NULL)
+        memcpy(map_owned + 2 * size, map_current.ceilings, size);
+    map_current.cells = map_owned;
+    map_current.floors = map_owned + size;
+    map_current.ceilings = map_owned + 2 * size;
+    fmap_close(&map_file);
+    return 0;
+}
+
+int map_load(const char* fname) {
+    map_header header;
+    int tiles_x, tiles_y, planes;
+
+    map_free();
+    if (fmap_open(fname, &map_file) != 0)
+        return -1;
+    if (map_file.size < sizeof(map_header))
+        goto bad_file;
+
+    memcpy(&header, map_file.data, sizeof(map_header));
+    if (memcmp(header.magic, MAP_MAGIC, 4) != 0 || header.tile_shift != MAP_TILE_SHIFT)
+        goto bad_file;
+    if (header.version == MAP_VERSION)
+        planes = MAP_PLANES;
+    else if (header.version == MAP_VERSION_CELLS)
+        planes = 1;
+    else
+        goto bad_file;
+    if (header.width == 0 || header.height == 0 || header.width > MAP_MAX_SIZE || header.height > MAP_MAX_SIZE)
+        goto bad_file;
+
+    tiles_x = (int)(header.width + MAP_TILE_MASK) >> MAP_TILE_SHIFT;
+    tiles_y = (int)(header.height + MAP_TILE_MASK) >> MAP_TILE_SHIFT;
+    if (map_file.size < sizeof(map_header) + planes * map_cells_size(tiles_x, tiles_y) + MAP_PADDING)
+        goto bad_file;
+
+    map_current.cells = (const unsigned char*)map_file.data + sizeof(map_header);
+    if (planes == MAP_PLANES) {
+        map_current.floors = map_current.cells + map_cells_size(tiles_x, tiles_y);
+        map_current.ceilings = map_current.floors + map_cells_size(tiles_x, tiles_y);
+    }
+    map_current.width = (int)header.width;
+    map_current.height = (int)header.height;
+    map_current.tiles_x = tiles_x;
+    map_current.tiles_y = tiles_y;
+    map_current.spawn_x = header.spawn_x;
+    map_current.spawn_y = header.spawn_y;
+    /* Take the cells out of the file straight away, so that changing them later never
+     * has to swap the memory out from under anyone. Working out the distance field
+     * reads every cell anyway. */
+    if (map_make_owned() != 0) {
+        map_free();
+        return -1;
+    }
+    return map_build_distance();
+
+bad_file:
+    fmap_close(&map_file);
+    return -1;
+}
+
+int map_save(const char* fname) {
+    static const unsigned char padding[MAP_PADDING] = { 0 };
+    map_header header;
+    size_t size;
+    FILE* file;
+    int plane;
+
+    if (map_current.cells == NULL)
+        return -1;
+
+    memcpy(header.magic, MAP_MAGIC, 4);
+    header.version = MAP_VERSION;
+    header.width = (Uint32)map_current.width;
+    header.height = (Uint32)map_current.height;
+    header.tile_shift = MAP_TILE_SHIFT;
+    header.spawn_x = map_current.spawn_x;
+    header.spawn_y = map_current.spawn_y;
+    header.reserved = 0;
+
+    file = fopen(fname, "wb");
+    if (file == NULL)
+        return -1;
+    size = map_cells_size(map_current.tiles_x, map_current.tiles_y);
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        goto bad_write;
+    for (plane = 0; plane < MAP_PLANES; plane++) {
+        const unsigned char* cells = plane == 0 ? map_current.cells : plane == 1 ? map_current.floors : map_current.ceilings;
+        size_t i;
+
+        /* An old map without floors or ceilings gets written out with plain ones. */
+        if (cells != NULL) {
+            if (fwrite(cells, 1, size, file) != size)
+                goto bad_write;
+        } else {
+            for (i = 0; i < size; i += MAP_PADDING) {
+                if (fwrite(padding, 1, MAP_PADDING, file) != MAP_PADDING)
+                    goto bad_write;
+            }
+        }
+    }
+    if (fwrite(padding, 1, MAP_PADDING, file) != MAP_PADDING)
+        goto bad_write;
+    return fclose(file) == 0 ? 0 : -1;
+
+bad_write:
+    fclose(file);
+    return -1;
+}
+
+int map_create(int width, int height) {
+    int tiles_x, tiles_y;
+
+    map_free();
+    if (width <= 0 || height <= 0 || width > MAP_MAX_SIZE || height > MAP_MAX_SIZE)
+        return -1;
+
+    tiles_x = (width + MAP_TILE_MASK) >> MAP_TILE_SHIFT;
+    tiles_y = (height + MAP_TILE_MASK) >> MAP_TILE_SHIFT;
+    map_owned = (unsigned char*)calloc(MAP_PLANES * map_cells_size(tiles_x, tiles_y) + MAP_PADDING, 1);
+    if (map_owned == NULL)
+        return -1;
+
+    map_current.cells = map_owned;
+    map_current.floors = map_owned + map_cells_size(tiles_x, tiles_y);
+    map_current.ceilings = map_current.floors + map_cells_size(tiles_x, tiles_y);
+    map_current.width = width;
+    map_current.height = height;
+    map_current.tiles_x = tiles_x;
+    map_current.tiles_y = tiles_y;
+    map_current.spawn_x = width / 2.0f;
+    map_current.spawn_y = height / 2.0f;
+    return 0;
+}
+
+int map_generate(int width, int height, unsigned int seed) {
+    int x, y;
+
+    if (map_create(width, height) != 0)
+        return -1;
+
+    /* Solid walls all the way around the outside, then a grid of rooms with
+     * doorways between them and some pillars scattered around inside. */
+    for (x = 0; x < width; x++) {
+        for (y = 0; y < height; y++) {
+            int value = 0;
+
+            seed = seed * 1664525u + 1013904223u;
+            if (x == 0 || y == 0 || x == width - 1 || y == height - 1)
+                value = 1 + ((x + y) & 1);
+            else if ((x % 32 == 0 && y % 32 != 16) || (y % 32 == 0 && x % 32 != 16))
+                value = 2;
+            else if ((seed >> 24) < 6)
+                value = 1;
+            map_set(x, y, value);
+            /* Each room gets its own floor and they all share a ceiling. */
+            map_set_floor(x, y, 1 + ((x / 32 + y / 32) & 1));
+            map_set_ceiling(x, y, 1);
+        }
+    }
+
+    /* Make sure the middle of the map is open to start in. */
+    for (x = width / 2 - 1; x <= width / 2 + 1; x++) {
+        for (y = height / 2 - 1; y <= height / 2 + 1; y++)
+            map_set(x, y, 0);
+    }
+    map_set_spawn(width / 2 + 0.5f, height / 2 + 0.5f);
+    return map_build_distance();
+}
+
+void map_free(void) {
+    fmap_close(&map_file);
+    free(map_owned);
+    free(map_distance);
+    map_owned = NULL;
+    map_distance = NULL;
+    memset(&map_current, 0, sizeof(map_current));
+    SDL_AtomicSet(&map_edit_head, 0);
+    SDL_AtomicSet(&map_edit_tail, 0);
+}
+
+const map_data* map_get_data(void) {
+    return &map_current;
+}
+
+int map_get(int x, int y) {
+    /* There is nothing outside of the map, not even empty space. */
+    if (map_current.cells == NULL || x < 0 || y < 0 || x >= map_current.width || y >= map_current.height)
+        return -1;
+    return map_current.cells[MAP_INDEX(map_current.tiles_x, x, y)];
+}
+
+void map_set(int x, int y, int value) {
+    int was_solid;
+
+    if (map_current.cells == NULL || x < 0 || y < 0 || x >= map_current.width || y >= map_current.height)
+        return;
+
+    was_solid = map_owned[MAP_INDEX(map_current.tiles_x, x, y)] > 0;
+    map_owned[MAP_INDEX(map_current.tiles_x, x, y)] = (unsigned char)value;
+
+    /* Changing one cell only changes the distance field around it. */
+    if (map_distance != NULL && was_solid != (value > 0))
+        map_update_distance(x, y);
+}
+
+int map_get_floor(int x, int y) {
+    if (map_current.floors == NULL || x < 0 || y < 0 || x >= map_current.width || y >= map_current.height)
+        return 0;
+    return map_current.floors[MAP_INDEX(map_current.tiles_x, x, y)];
+}
+
+int map_get_ceiling(int x, int y) {
+    if (map_current.ceilings == NULL || x < 0 || y < 0 || x >= map_current.width || y >= map_current.height)
+        return 0;
+    return map_current.ceilings[MAP_INDEX(map_current.tiles_x, x, y)];
+}
+
+void map_set_floor(int x, int y, int value) {
+    if (map_current.cells == NULL || x < 0 || y < 0 || x >= map_current.width || y >= map_current.height)
+        return;
+    map_owned[map_current.floors - map_owned + MAP_INDEX(map_current.tiles_x, x, y)] = (unsigned char)value;
+}
+
+void map_set_ceiling(int x, int y, int value) {
+    if (map_current.cells == NULL || x < 0 || y < 0 || x >= map_current.width || y >= map_current.height)
+        return;
+    map_owned[map_current.ceilings - map_owned + MAP_INDEX(map_current.tiles_x, x, y)] = (unsigned char)value;
+}
+
+void map_set_spawn(float x, float y) {
+    map_current.spawn_x = x;
+    map_current.spawn_y = y;
+}
+
+/* Returns -1 if the queue is full, in which case the change is dropped. */
+int map_queue_set(int x, int y, int value) {
+    int head = SDL_AtomicGet(&map_edit_head);
+    map_edit* edit;
+
+    if (head - SDL_AtomicGet(&map_edit_tail) >= MAP_MAX_EDITS)
+        return -1;
+    edit = &map_edits[head % MAP_MAX_EDITS];
+    edit->x = x;
+    edit->y = y;
+    edit->value = value;
+    /* The change has to be filled in before it shows up at the head. */
+    SDL_AtomicSet(&map_edit_head, head + 1);
+    return 0;
+}
+
+int map_get_edit_count(void) {
+    return SDL_AtomicGet(&map_edit_head) - SDL_AtomicGet(&map_edit_tail);
+}
+
+/* Everything queued so far goes in, in the order that it was queued. Anything that gets
+ * queued while this is going waits for the next time. */
+void map_apply_edits(void) {
+    int head = SDL_AtomicGet(&map_edit_head);
+    int tail = SDL_AtomicGet(&map_edit_tail);
+
+    for (; tail != head; tail++) {
+        const map_edit* edit = &map_edits[tail % MAP_MAX_EDITS];
+        map_set(edit->x, edit->y, edit->value);
+    }
+    SDL_AtomicSet(&map_edit_tail, tail);
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <SDL.h>
+#include "pool.h"
+#include "prof.h"
+
+#define POOL_MAX_WORKERS                (64)
+#define POOL_CACHE_LINE                 (64)
+
+/* Every worker owns a range of chunks that it works through from the front. Once
+ * it runs out, it goes looking through everyone else's range and takes whatever
+ * is left. Both the owner and the thieves take chunks the same way so a single
+ * atomic counter per worker is all that is needed. Each queue gets its own cache
+ * line so that workers do not fight over the same line while they are busy. */
+typedef struct {
+    SDL_atomic_t next;
+    int end;
+    char pad[POOL_CACHE_LINE - sizeof(SDL_atomic_t) - sizeof(int)];
+} pool_queue;
+
+/* One worker thread only needs to know which pool it is in and which queue is its own. */
+typedef struct {
+    pool* owner;
+    int id;
+} pool_worker;
+
+struct pool {
+    pool_queue queues[POOL_MAX_WORKERS];
+    pool_worker workers[POOL_MAX_WORKERS];
+    SDL_Thread* threads[POOL_MAX_WORKERS];
+    int worker_count;
+
+    /* The job that is currently being worked on. */
+    pool_job current_job;
+    void* current_data;
+    int current_count;
+    int current_chunk;
+
+    /* Used to wake up the workers when there is a new job and to let the caller
+     * know that everyone is finished with it. */
+    SDL_mutex* lock;
+    SDL_cond* start;
+    SDL_cond* done;
+    int generation;
+    int busy;
+    int quit;
+    /* There is only one job at a time. Whoever holds this is the one running it. */
+    SDL_mutex* caller;
+};
+
+static void pool_work(pool* p, int id) {
+    int victim, chunk, begin, end;
+
+    /* Start with our own queue and then move on to stealing from the others. */
+    for (victim = 0; victim < p->worker_count; victim++) {
+        pool_queue* queue = &p->queues[(id + victim) % p->worker_count];
+
+        for (;;) {
+            chunk = SDL_AtomicAdd(&queue->next, 1);
+            if (chunk >= queue->end)
+                break;
+
+            begin = chunk * p->current_chunk;
+            end = begin + p->current_chunk;
+            if (end > p->current_count)
+                end = p->current_count;
+            p->current_job(p->current_data, begin, end);
+        }
+    }
+}
+
+static int pool_thread(void* data) {
+    pool_worker* worker = (pool_worker*)data;
+    pool* p = worker->owner;
+    int seen = 0;
+
+    PROF_THREAD("pool");
+
+    for (;;) {
+        SDL_LockMutex(p->lock);
+        while (p->generation == seen && !p->quit)
+            SDL_CondWait(p->start, p->lock);
+        if (p->quit) {
+            SDL_UnlockMutex(p->lock);
+            break;
+        }
+        seen = p->generation;
+        SDL_UnlockMutex(p->lock);
+
+        pool_work(p, worker->id);
+
+        /* The caller can not hand out the next job until every worker has stopped
+         * looking at the queues, otherwise a late thief might pick up a chunk of the
+         * next job while still thinking it belongs to this one. */
+        SDL_LockMutex(p->lock);
+        p->busy--;
+        if (p->busy == 0)
+            SDL_CondSignal(p->done);
+        SDL_UnlockMutex(p->lock);
+    }
+    return 0;
+}
+
+pool* pool_create(int workers) {
+    pool* p;
+    int i;
+
+    /* Default to one worker for each core. */
+    if (workers <= 0)
+        workers = SDL_GetCPUCount();
+    if (workers <= 0)
+        workers = 1;
+    if (workers > POOL_MAX_WORKERS)
+        workers = POOL_MAX_WORKERS;
+
+    p = (pool*)calloc(1, sizeof(pool));
+    if (p == NULL)
+        return NULL;
+    p->lock = SDL_CreateMutex();
+    p->start = SDL_CreateCond();
+    p->done = SDL_CreateCond();
+    p->caller = SDL_CreateMutex();
+    if (p->lock == NULL || p->start == NULL || p->done == NULL || p->caller == NULL) {
+        pool_free(p);
+        return NULL;
+    }
+
+    /* The calling thread does its share of the work too so it counts as worker 0. */
+    p->worker_count = 1;
+    for (i = 1; i < workers; i++) {
+        p->workers[i].owner = p;
+        p->workers[i].id = i;
+        p->threads[i] = SDL_CreateThread(pool_thread, "pool", &p->workers[i]);
+        if (p->threads[i] == NULL)
+            break;
+        p->worker_count++;
+    }
+    return p;
+}
+
+void pool_free(pool* p) {
+    int i;
+
+    if (p == NULL)
+        return;
+    if (p->lock != NULL) {
+        SDL_LockMutex(p->lock);
+        p->quit = 1;
+        SDL_CondBroadcast(p->start);
+        SDL_UnlockMutex(p->lock);
+    }
+    for (i = 1; i < p->worker_count; i++)
+        SDL_WaitThread(p->threads[i], NULL);
+
+    if (p->done != NULL)
+        SDL_DestroyCond(p->done);
+    if (p->start != NULL)
+        SDL_DestroyCond(p->start);
+    if (p->lock != NULL)
+        SDL_DestroyMutex(p->lock);
+    if (p->caller != NULL)
+        SDL_DestroyMutex(p->caller);
+    free(p);
+}
+
+int pool_get_workers(const pool* p) {
+    return p != NULL ? p->worker_count : 1;
+}
+
+void pool_run(pool* p, pool_job job, void* data, int count, int chunk) {
+    int i, chunks;
+
+    if (count <= 0)
+        return;
+    if (chunk <= 0)
+        chunk = 1;
+
+    /* Nobody to share with so just do all of it right here. The same goes for when
+     * the workers are already busy with a job from another thread. Rather than wait
+     * for them to finish, that thread gets on with its own job by itself, so any
+     * number of threads can run jobs at once and none of them ever holds up another. */
+    if (p == NULL || p->worker_count <= 1 || SDL_TryLockMutex(p->caller) != 0) {
+        job(data, 0, count);
+        return;
+    }
+
+    p->current_job = job;
+    p->current_data = data;
+    p->current_count = count;
+    p->current_chunk = chunk;
+
+    /* Hand every worker an even share of the chunks to begin with. */
+    chunks = (count + chunk - 1) / chunk;
+    for (i = 0; i < p->worker_count; i++) {
+        SDL_AtomicSet(&p->queues[i].next, (int)((Sint64)chunks * i / p->worker_count));
+        p->queues[i].end = (int)((Sint64)chunks * (i + 1) / p->worker_count);
+    }
+
+    SDL_LockMutex(p->lock);
+    p->generation++;
+    p->busy = p->worker_count - 1;
+    SDL_CondBroadcast(p->start);
+    SDL_UnlockMutex(p->lock);
+
+    pool_work(p, 0);
+
+    PROF_BEGIN(wait);
+    SDL_LockMutex(p->lock);
+    while (p->busy > 0)
+        SDL_CondWait(p->done, p->lock);
+    SDL_UnlockMutex(p->lock);
+    PROF_END(wait, "pool wait");
+    SDL_UnlockMutex(p->caller);
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "bench.h"
+#include "probe.h"
+
+/* Measures how long it takes from a key changing to the first frame drawn with it
+ * being presented. Every change gets a number in the order they come in. The
+ * renderer notes the newest number that it has seen when it picks up the keys for a
+ * frame, and once that frame is presented everything up to that number is done. */
+static Uint64 probe_times[PROBE_PENDING];
+static int probe_next = 0;
+static int probe_presented = 0;
+static SDL_atomic_t probe_published;
+
+/* The most recent measurements in seconds, from a key changing and from the keys
+ * being picked up for a frame, both up to that frame being presented. */
+static double probe_samples[PROBE_MAX_SAMPLES];
+static int probe_sample_count = 0;
+static double probe_latch_samples[PROBE_MAX_SAMPLES];
+static int probe_latch_count = 0;
+
+void probe_input(void) {
+    probe_times[probe_next % PROBE_PENDING] = SDL_GetPerformanceCounter();
+    probe_next++;
+}
+
+void probe_publish(void) {
+    /* The keys have to be handed over before this so that any frame which sees the
+     * new number is sure to see the keys that go with it too. */
+    SDL_AtomicSet(&probe_published, probe_next);
+}
+
+/* The renderer can already be picking up the keys for the next frame while the last one
+ * is being presented, so when it picked them up goes along with the frame. */
+int probe_latch(Uint64* latch_time) {
+    *latch_time = SDL_GetPerformanceCounter();
+    return SDL_AtomicGet(&probe_published);
+}
+
+void probe_present(int latched, Uint64 latch_time) {
+    double freq = (double)SDL_GetPerformanceFrequency();
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    /* Anything that has already been pushed out of the pending ring is skipped. */
+    if (probe_presented < probe_next - PROBE_PENDING)
+        probe_presented = probe_next - PROBE_PENDING;
+    for (; probe_presented < latched; probe_presented++) {
+        probe_samples[probe_sample_count % PROBE_MAX_SAMPLES] = (double)(now - probe_times[probe_presented % PROBE_PENDING]) / freq;
+        probe_sample_count++;
+    }
+    probe_latch_samples[probe_latch_count % PROBE_MAX_SAMPLES] = (double)(now - latch_time) / freq;
+    probe_latch_count++;
+}
+
+static void probe_print(const char* what, const double* samples, int total) {
+    int count = total < PROBE_MAX_SAMPLES ? total : PROBE_MAX_SAMPLES;
+    double sorted[PROBE_MAX_SAMPLES];
+
+    if (count == 0) {
+        printf("%s: nothing was presented\n", what);
+        return;
+    }
+    memcpy(sorted, samples, (size_t)count * sizeof(double));
+    bench_sort(sorted, count);
+    printf("%s: %d samples, min %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+        what, total, sorted[0] * 1000.0, bench_percentile(sorted, count, 50.0) * 1000.0,
+        bench_percentile(sorted, count, 95.0) * 1000.0, bench_percentile(sorted, count, 99.0) * 1000.0,
+        sorted[count - 1] * 1000.0);
+}
+
+void probe_report(void) {
+    /* The first is the whole wait that someone pressing a key sees. The second is only
+     * the part after the keys were picked up, which is drawing and presenting. */
+    probe_print("input to present", probe_samples, probe_sample_count);
+    probe_print("latch to present", probe_latch_samples, probe_latch_count);
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "prof.h"
+
+#ifdef PROF_ENABLED
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define PROF_MAX_THREADS                (64)
+/* How many zones each thread remembers, once it is full the oldest ones get
+ * written over. Has to be a power of two. */
+#define PROF_MAX_EVENTS                 (1 << 16)
+
+#if defined(_MSC_VER)
+#define PROF_THREAD_LOCAL               __declspec(thread)
+#else
+#define PROF_THREAD_LOCAL               __thread
+#endif
+
+typedef struct {
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+} prof_event;
+
+/* Only the thread that owns a buffer ever writes to it. */
+typedef struct {
+    prof_event events[PROF_MAX_EVENTS];
+    Uint32 count;
+    int id;
+    const char* name;
+} prof_buffer;
+
+static prof_buffer* prof_buffers[PROF_MAX_THREADS] = { NULL };
+static SDL_atomic_t prof_buffer_count = { 0 };
+static PROF_THREAD_LOCAL prof_buffer* prof_local = NULL;
+
+static prof_buffer* prof_get_buffer(void) {
+    int slot;
+
+    if (prof_local != NULL)
+        return prof_local;
+
+    /* First zone on this thread so claim a slot for it. Once they are all gone the
+     * count stays put, otherwise every zone on a thread without one would bump it. */
+    do {
+        slot = SDL_AtomicGet(&prof_buffer_count);
+        if (slot >= PROF_MAX_THREADS)
+            return NULL;
+    } while (!SDL_AtomicCAS(&prof_buffer_count, slot, slot + 1));
+    prof_local = (prof_buffer*)calloc(1, sizeof(prof_buffer));
+    if (prof_local == NULL)
+        return NULL;
+    prof_local->id = slot;
+    prof_local->name = "thread";
+    SDL_AtomicSetPtr((void**)&prof_buffers[slot], prof_local);
+    return prof_local;
+}
+
+void prof_record(const char* name, Uint64 start, Uint64 end) {
+    prof_buffer* buffer = prof_get_buffer();
+    prof_event* event;
+
+    if (buffer == NULL)
+        return;
+    event = &buffer->events[buffer->count & (PROF_MAX_EVENTS - 1)];
+    event->name = name;
+    event->start = start;
+    event->end = end;
+    /* Make sure the event is all there before anyone can see the new count. */
+    SDL_MemoryBarrierRelease();
+    buffer->count++;
+}
+
+void prof_name_thread(const char* name) {
+    prof_buffer* buffer = prof_get_buffer();
+    if (buffer != NULL)
+        buffer->name = name;
+}
+
+int prof_dump(const char* fname) {
+    FILE* file;
+    double to_us = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+    Uint64 base = 0;
+    int slot, slots, first = 1;
+    Uint32 i, begin, count;
+
+    if (fname == NULL)
+        return -1;
+    file = fopen(fname, "w");
+    if (file == NULL)
+        return -1;
+
+    slots = SDL_AtomicGet(&prof_buffer_count);
+    if (slots > PROF_MAX_THREADS)
+        slots = PROF_MAX_THREADS;
+
+    /* Everything is written relative to the oldest zone that we still have. */
+    for (slot = 0; slot < slots; slot++) {
+        prof_buffer* buffer = (prof_buffer*)SDL_AtomicGetPtr((void**)&prof_buffers[slot]);
+        if (buffer == NULL)
+            continue;
+        SDL_MemoryBarrierAcquire();
+        count = buffer->count;
+        begin = count > PROF_MAX_EVENTS ? count - PROF_MAX_EVENTS : 0;
+        for (i = begin; i < count; i++) {
+            Uint64 start = buffer->events[i & (PROF_MAX_EVENTS - 1)].start;
+            if (base == 0 || start < base)
+                base = start;
+        }
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (slot = 0; slot < slots; slot++) {
+        prof_buffer* buffer = (prof_buffer*)SDL_AtomicGetPtr((void**)&prof_buffers[slot]);
+        if (buffer == NULL)
+            continue;
+        SDL_MemoryBarrierAcquire();
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+            first ? "" : ",\n", buffer->id, buffer->name, buffer->id);
+        first = 0;
+
+        count = buffer->count;
+        begin = count > PROF_MAX_EVENTS ? count - PROF_MAX_EVENTS : 0;
+        for (i = begin; i < count; i++) {
+            const prof_event* event = &buffer->events[i & (PROF_MAX_EVENTS - 1)];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event->name, buffer->id, (double)(event->start - base) * to_us, (double)(event->end - event->start) * to_us);
+        }
+    }
+    /* The base goes in too so that anything else stamped with the same clock, like
+     * captured frames, can be lined up with the zones. */
+    fprintf(file, "\n],\"otherData\":{\"base_us\":\"%.3f\"}}\n", (double)base * to_us);
+    fclose(file);
+    return 0;
+}
+
+void prof_free(void) {
+    int slot;
+
+    /* Only safe once we are shutting down and the other threads have stopped recording. */
+    for (slot = 0; slot < PROF_MAX_THREADS; slot++) {
+        free(prof_buffers[slot]);
+        prof_buffers[slot] = NULL;
+    }
+    SDL_AtomicSet(&prof_buffer_count, 0);
+    prof_local = NULL;
+}
+
+#endif
\ No newline at end of file
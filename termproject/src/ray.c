@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <math.h>
+#include <SDL.h>
+#include "ray.h"
+
+typedef void (*ray_cast_func)(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits);
+
+/* The vector kernels live in ray_simd.c. They have to give exactly the same
+ * results as the scalar versions below which are kept as the reference. */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RAY_HAS_X86
+void ray_cast_sse2(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits);
+void ray_cast_avx2(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits);
+#endif
+
+/* The fixed point kernel lives in ray_fixed.c. It is a renderer of its own rather
+ * than a faster way of getting the same answer, so it never has to match. */
+void ray_cast_fixed_world(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits);
+
+static ray_world ray_current = { NULL, NULL, 0, 0, 0, RAY_MAX_DISTANCE };
+/* Cells only ever change in between frames, but a different map can get loaded
+ * after this is set, so we look at it again every time we cast. */
+static const map_data* ray_map = NULL;
+
+static void ray_cast_scalar(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits);
+
+static int ray_isa = RAY_ISA_SCALAR;
+static ray_cast_func ray_cast_kernel = ray_cast_scalar;
+
+/* Takes every step that the DDA would have taken before leaving the square of empty
+ * blocks that reaches out reach blocks on every side of the one we are in. The steps
+ * are counted rather than taken so this only costs a few tries to find out how many
+ * steps along the other direction fit in before the ray leaves. */
+static void ray_skip(int reach, float first_x, float delta_x, float first_y, float delta_y, float max_distance,
+    int* steps_x, int* steps_y, int* side) {
+    float exit_x = RAY_SIDE_DIST(first_x, *steps_x + reach, delta_x);
+    float exit_y = RAY_SIDE_DIST(first_y, *steps_y + reach, delta_y);
+    float last_x, last_y;
+    int new_x, new_y;
+    int low, high;
+
+    /* Ties go to y steps, just like they do when stepping normally. */
+    if (exit_x < exit_y) {
+        /* The ray leaves through an x side. Every y step up until then is taken too. */
+        new_x = *steps_x + reach;
+        low = *steps_y;
+        high = *steps_y + reach;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (RAY_SIDE_DIST(first_y, middle, delta_y) > exit_x)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        new_y = low;
+    } else {
+        new_y = *steps_y + reach;
+        low = *steps_x;
+        high = *steps_x + reach;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (RAY_SIDE_DIST(first_x, middle, delta_x) >= exit_y)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        new_x = low;
+    }
+
+    /* The last step that got taken decides which side we are on and how far we went.
+     * If that is past the end of the ray then step normally so that it stops at the
+     * same place. */
+    last_x = RAY_SIDE_DIST(first_x, new_x - 1, delta_x);
+    last_y = RAY_SIDE_DIST(first_y, new_y - 1, delta_y);
+    if (new_y > *steps_y && (new_x == *steps_x || last_x < last_y)) {
+        if (last_y > max_distance)
+            return;
+        *side = 1;
+    } else {
+        if (last_x > max_distance)
+            return;
+        *side = 0;
+    }
+    *steps_x = new_x;
+    *steps_y = new_y;
+}
+
+static void ray_cast_scalar(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits) {
+    int x;
+
+    for (x = begin; x < end; x++) {
+        ray_hit* hit_info = &hits[x - begin];
+        /* Get the x-coordinate on the camera plane. This is the traditional camera plane
+         * where 0 is in the center, -1 on the left, etc. We will use this to figure out
+         * where our ray is. */
+        float x_in_camera = (2 * x) / (float)(width) - 1;
+        /* Calculate the position of the ray and the direction. */
+        float ray_dir_x = camera->dir_x + camera->plane_x * x_in_camera;
+        float ray_dir_y = camera->dir_y + camera->plane_y * x_in_camera;
+        /* Figure out the distances between blocks in the map that our ray has to travel throuh. This
+         * is done to prevent stepping along the ray which has the chance of missing a wall. To prevent,
+         * that we are using DDA ray collision detection. */
+        float delta_dist_x;
+        float delta_dist_y;
+        /* Which block on the map we are in. */
+        int map_x = (int)camera->x;
+        int map_y = (int)camera->y;
+        /* Length of the ray from the camera to the first x or y side of a block in the map. */
+        float side_dist_x;
+        float side_dist_y;
+        /* How many blocks the ray has stepped over in each direction. */
+        int steps_x = 0;
+        int steps_y = 0;
+        /* How many blocks around the one the ray is in are known to be empty. */
+        int reach = 0;
+        /* The length of the ray. */
+        float perp_wall_dist;
+        /* The direction that the ray will be stepping in. */
+        int step_x;
+        int step_y;
+        /* Did the ray hit a wall and what was in the block it hit? */
+        int hit = 0;
+        int cell = 0;
+        /* Was it a horizontal or vertcal face of the wall that we hit? */
+        int side = 0;
+        /* Where along the wall the ray hit. */
+        float wall_x;
+
+        /* A ray that runs straight along one axis never crosses a side in the other
+         * direction, the other distance is worked out as usual. */
+        delta_dist_x = ray_dir_x == 0.0f ? RAY_NEVER : fabsf(1.0f / ray_dir_x);
+        delta_dist_y = ray_dir_y == 0.0f ? RAY_NEVER : fabsf(1.0f / ray_dir_y);
+
+        /* Calculate the step direction and the starting side distance. */
+        if (ray_dir_x < 0.0f) {
+            step_x = -1;
+            side_dist_x = (camera->x - map_x) * delta_dist_x;
+        } else {
+            step_x = 1;
+            side_dist_x = (map_x + 1.0f - camera->x) * delta_dist_x;
+        }
+
+        if (ray_dir_y < 0.0f) {
+            step_y = -1;
+            side_dist_y = (camera->y - map_y) * delta_dist_y;
+        } else {
+            step_y = 1;
+            side_dist_y = (map_y + 1.0f - camera->y) * delta_dist_y;
+        }
+
+        if (world->distance != NULL && map_x >= 0 && map_y >= 0 && map_x < world->map_width && map_y < world->map_height)
+            reach = world->distance[MAP_INDEX(world->tiles_x, map_x, map_y)] - 1;
+
+        /* This loop is the actuall DDA collision algorithm. It will move the ray through
+         * all the blocks in the map until it hits a wall, leaves the map or has gone
+         * further than we can see. */
+        while (hit == 0) {
+            /* How far along the ray we are when we step into the next block. */
+            float travelled;
+            float next_x;
+            float next_y;
+
+            /* Skip over as much empty space as we can. */
+            if (reach > 0) {
+                ray_skip(reach, side_dist_x, delta_dist_x, side_dist_y, delta_dist_y, world->max_distance,
+                    &steps_x, &steps_y, &side);
+                map_x = (int)camera->x + step_x * steps_x;
+                map_y = (int)camera->y + step_y * steps_y;
+            }
+
+            /* Jump to the next block in the map in the x direction or y direction. */
+            next_x = RAY_SIDE_DIST(side_dist_x, steps_x, delta_dist_x);
+            next_y = RAY_SIDE_DIST(side_dist_y, steps_y, delta_dist_y);
+            if (next_x < next_y) {
+                travelled = next_x;
+                steps_x++;
+                map_x += step_x;
+                side = 0;
+            } else {
+                travelled = next_y;
+                steps_y++;
+                map_y += step_y;
+                side = 1;
+            }
+
+            /* Give up if there is nothing left to find. */
+            if (map_x < 0 || map_y < 0 || map_x >= world->map_width || map_y >= world->map_height || travelled > world->max_distance)
+                break;
+
+            /* Check to see if we hit a solid block. The distance field is 0 for those
+             * so it is all that we need to look at when we have it. */
+            if (world->distance != NULL) {
+                reach = world->distance[MAP_INDEX(world->tiles_x, map_x, map_y)] - 1;
+                if (reach < 0) {
+                    cell = world->cells[MAP_INDEX(world->tiles_x, map_x, map_y)];
+                    hit = 1;
+                }
+            } else {
+                cell = world->cells[MAP_INDEX(world->tiles_x, map_x, map_y)];
+                if (cell > 0)
+                    hit = 1;
+            }
+        }
+
+        /* Calculate the distance projected in the camera direction. We will be using the camera
+         * plane to avoid the fisheye effect. If we use the real-world distance from the camera
+         * position in the scene to the wall, the distance will be longer on the sides since the
+         * ray on the side is not travelling in a straight line. The distance change will cause the
+         * wall to be drawn at a smaller size near the edges then it will in the center and cause the
+         * rounded fisheye effect. */
+        if (side == 0)
+            perp_wall_dist = (map_x - camera->x + (1 - step_x) / 2) / ray_dir_x;
+        else
+            perp_wall_dist = (map_y - camera->y + (1 - step_y) / 2) / ray_dir_y;
+
+        /* Where exactly along the wall did we hit it? */
+        if (side == 0)
+            wall_x = camera->y + perp_wall_dist * ray_dir_y;
+        else
+            wall_x = camera->x + perp_wall_dist * ray_dir_x;
+        wall_x -= floorf(wall_x);
+
+        hit_info->ray_dir_x = ray_dir_x;
+        hit_info->ray_dir_y = ray_dir_y;
+        hit_info->perp_wall_dist = perp_wall_dist;
+        hit_info->wall_x = wall_x;
+        hit_info->map_x = map_x;
+        hit_info->map_y = map_y;
+        hit_info->cell = hit ? cell : 0;
+        hit_info->side = side;
+        /* How tall the sliver of wall on this column of the screen is. */
+        hit_info->line_height = (int)((float)(height) / perp_wall_dist);
+    }
+}
+
+void ray_set_map(const map_data* map) {
+    ray_map = map;
+}
+
+void ray_set_max_distance(float max_distance) {
+    ray_current.max_distance = max_distance;
+}
+
+int ray_select_isa(int isa) {
+    int best = RAY_ISA_SCALAR;
+
+    /* Find out what the processor we are running on can actually do. */
+#ifdef RAY_HAS_X86
+    if (SDL_HasSSE2())
+        best = RAY_ISA_SSE2;
+    if (SDL_HasAVX2())
+        best = RAY_ISA_AVX2;
+#endif
+    if (isa < 0 || isa > best)
+        isa = best;
+
+    switch (isa) {
+#ifdef RAY_HAS_X86
+    case RAY_ISA_AVX2:
+        ray_cast_kernel = ray_cast_avx2;
+        break;
+    case RAY_ISA_SSE2:
+        ray_cast_kernel = ray_cast_sse2;
+        break;
+#endif
+    default:
+        isa = RAY_ISA_SCALAR;
+        ray_cast_kernel = ray_cast_scalar;
+        break;
+    }
+    ray_isa = isa;
+    return isa;
+}
+
+int ray_get_isa(void) {
+    return ray_isa;
+}
+
+static int ray_get_world(ray_world* world) {
+    if (ray_map == NULL || ray_map->cells == NULL)
+        return -1;
+    *world = ray_current;
+    world->cells = ray_map->cells;
+    world->distance = ray_map->distance;
+    world->map_width = ray_map->width;
+    world->map_height = ray_map->height;
+    world->tiles_x = ray_map->tiles_x;
+    return 0;
+}
+
+void ray_cast(const ray_camera* camera, int width, int height, int begin, int end, ray_hit* hits) {
+    ray_world world;
+
+    if (ray_get_world(&world) == 0)
+        ray_cast_kernel(camera, &world, width, height, begin, end, hits);
+}
+
+void ray_cast_fixed(const ray_camera* camera, int width, int height, int begin, int end, ray_hit* hits) {
+    ray_world world;
+
+    if (ray_get_world(&world) == 0)
+        ray_cast_fixed_world(camera, &world, width, height, begin, end, hits);
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include "ray.h"
+
+/* Ray casting done all in 16.16 fixed point. The camera is turned into fixed point on
+ * the way in and from there it is the same DDA as ray.c with whole numbers instead of
+ * floats, so the same camera always hits the same walls at the same distances whatever
+ * it gets compiled with or runs on. Whole numbers also add up exactly which means the
+ * steps can be added one at a time and skipping ahead still lands in the same place.
+ * The only thing to watch is that the distances the skipping looks ahead to can get
+ * too big for 32 bits, so those get worked out in 64. */
+#define RAY_FIXED_SIDE_DIST(first, steps, delta) ((long long)(first) + (long long)(steps) * (delta))
+
+void ray_camera_to_fixed(const ray_camera* camera, ray_fixed_camera* fixed_camera) {
+    fixed_camera->x = fixed_from_float(camera->x);
+    fixed_camera->y = fixed_from_float(camera->y);
+    fixed_camera->dir_x = fixed_from_float(camera->dir_x);
+    fixed_camera->dir_y = fixed_from_float(camera->dir_y);
+    fixed_camera->plane_x = fixed_from_float(camera->plane_x);
+    fixed_camera->plane_y = fixed_from_float(camera->plane_y);
+}
+
+/* How far the ray goes between sides in one direction. A ray that hardly moves that
+ * way at all would take longer to get to one than any ray goes. */
+static fixed ray_fixed_delta(fixed ray_dir) {
+    fixed delta;
+
+    if (ray_dir == 0)
+        return RAY_FIXED_NEVER;
+    delta = fixed_reciprocal(ray_dir < 0 ? -ray_dir : ray_dir);
+    return delta > RAY_FIXED_NEVER ? RAY_FIXED_NEVER : delta;
+}
+
+/* The same as ray_skip in ray.c. */
+static void ray_skip_fixed(int reach, fixed first_x, fixed delta_x, fixed first_y, fixed delta_y, fixed max_distance,
+    int* steps_x, int* steps_y, int* side) {
+    long long exit_x = RAY_FIXED_SIDE_DIST(first_x, *steps_x + reach, delta_x);
+    long long exit_y = RAY_FIXED_SIDE_DIST(first_y, *steps_y + reach, delta_y);
+    long long last_x, last_y;
+    int new_x, new_y;
+    int low, high;
+
+    /* Ties go to y steps, just like they do when stepping normally. */
+    if (exit_x < exit_y) {
+        new_x = *steps_x + reach;
+        low = *steps_y;
+        high = *steps_y + reach;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (RAY_FIXED_SIDE_DIST(first_y, middle, delta_y) > exit_x)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        new_y = low;
+    } else {
+        new_y = *steps_y + reach;
+        low = *steps_x;
+        high = *steps_x + reach;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (RAY_FIXED_SIDE_DIST(first_x, middle, delta_x) >= exit_y)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        new_x = low;
+    }
+
+    last_x = RAY_FIXED_SIDE_DIST(first_x, new_x - 1, delta_x);
+    last_y = RAY_FIXED_SIDE_DIST(first_y, new_y - 1, delta_y);
+    if (new_y > *steps_y && (new_x == *steps_x || last_x < last_y)) {
+        if (last_y > max_distance)
+            return;
+        *side = 1;
+    } else {
+        if (last_x > max_distance)
+            return;
+        *side = 0;
+    }
+    *steps_x = new_x;
+    *steps_y = new_y;
+}
+
+void ray_cast_fixed_world(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits) {
+    ray_fixed_camera view;
+    /* Any further and the distances would stop fitting. */
+    const fixed max_distance = world->max_distance < (float)RAY_FIXED_MAX_DISTANCE ?
+        fixed_from_float(world->max_distance) : FIXED_FROM_INT(RAY_FIXED_MAX_DISTANCE);
+    int start_x, start_y;
+    fixed near_x, near_y;
+    int start_reach = 0;
+    int x;
+
+    /* Every ray starts in the same block, the same distance from each of its sides. */
+    ray_camera_to_fixed(camera, &view);
+    start_x = FIXED_TO_INT(view.x);
+    start_y = FIXED_TO_INT(view.y);
+    near_x = view.x & FIXED_FRACTION;
+    near_y = view.y & FIXED_FRACTION;
+    if (world->distance != NULL && start_x >= 0 && start_y >= 0 && start_x < world->map_width && start_y < world->map_height)
+        start_reach = world->distance[MAP_INDEX(world->tiles_x, start_x, start_y)] - 1;
+
+    for (x = begin; x < end; x++) {
+        ray_hit* hit_info = &hits[x - begin];
+        /* Where the column is on the camera plane, -1 on the left to 1 on the right. */
+        fixed x_in_camera = (fixed)((long long)(2 * x - width) * FIXED_ONE / width);
+        fixed ray_dir_x = view.dir_x + FIXED_MUL(view.plane_x, x_in_camera);
+        fixed ray_dir_y = view.dir_y + FIXED_MUL(view.plane_y, x_in_camera);
+        fixed delta_dist_x = ray_fixed_delta(ray_dir_x);
+        fixed delta_dist_y = ray_fixed_delta(ray_dir_y);
+        int step_x = ray_dir_x < 0 ? -1 : 1;
+        int step_y = ray_dir_y < 0 ? -1 : 1;
+        fixed side_dist_x = FIXED_MUL(ray_dir_x < 0 ? near_x : FIXED_ONE - near_x, delta_dist_x);
+        fixed side_dist_y = FIXED_MUL(ray_dir_y < 0 ? near_y : FIXED_ONE - near_y, delta_dist_y);
+        int map_x = start_x;
+        int map_y = start_y;
+        int steps_x = 0;
+        int steps_y = 0;
+        int reach = start_reach;
+        int hit = 0;
+        int cell = 0;
+        int side = 0;
+        /* The length of the ray when it went into the block it stopped in. Since the ray
+         * directions all reach the camera plane at 1 this is already straight out from the
+         * camera plane, there is no fisheye to take out. */
+        fixed travelled = 0;
+        fixed wall_x;
+
+        while (hit == 0) {
+            fixed next_x;
+            fixed next_y;
+
+            if (reach > 0) {
+                ray_skip_fixed(reach, side_dist_x, delta_dist_x, side_dist_y, delta_dist_y, max_distance,
+                    &steps_x, &steps_y, &side);
+                map_x = start_x + step_x * steps_x;
+                map_y = start_y + step_y * steps_y;
+            }
+
+            next_x = side_dist_x + steps_x * delta_dist_x;
+            next_y = side_dist_y + steps_y * delta_dist_y;
+            if (next_x < next_y) {
+                travelled = next_x;
+                steps_x++;
+                map_x += step_x;
+                side = 0;
+            } else {
+                travelled = next_y;
+                steps_y++;
+                map_y += step_y;
+                side = 1;
+            }
+
+            if (map_x < 0 || map_y < 0 || map_x >= world->map_width || map_y >= world->map_height || travelled > max_distance)
+                break;
+
+            if (world->distance != NULL) {
+                reach = world->distance[MAP_INDEX(world->tiles_x, map_x, map_y)] - 1;
+                if (reach < 0) {
+                    cell = world->cells[MAP_INDEX(world->tiles_x, map_x, map_y)];
+                    hit = 1;
+                }
+            } else {
+                cell = world->cells[MAP_INDEX(world->tiles_x, map_x, map_y)];
+                if (cell > 0)
+                    hit = 1;
+            }
+        }
+
+        /* Where exactly along the wall did we hit it? */
+        if (side == 0)
+            wall_x = view.y + FIXED_MUL(travelled, ray_dir_y);
+        else
+            wall_x = view.x + FIXED_MUL(travelled, ray_dir_x);
+        wall_x &= FIXED_FRACTION;
+
+        hit_info->ray_dir_x = fixed_to_float(ray_dir_x);
+        hit_info->ray_dir_y = fixed_to_float(ray_dir_y);
+        hit_info->perp_wall_dist = fixed_to_float(travelled);
+        hit_info->wall_x = fixed_to_float(wall_x);
+        hit_info->map_x = map_x;
+        hit_info->map_y = map_y;
+        hit_info->cell = hit ? cell : 0;
+        hit_info->side = side;
+        /* A whole number over a fixed point one comes out as a whole number. */
+        hit_info->line_height = fixed_divide(height, travelled);
+        hit_info->fixed_perp_wall_dist = travelled;
+        hit_info->fixed_wall_x = wall_x;
+    }
+}
\ No newline at end of file
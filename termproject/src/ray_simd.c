@@ -0,0 +1,476 @@
+#include <SDL.h>
+#include "ray.h"
+
+/* Vector versions of the ray casting in ray.c. Each one traces a packet of
+ * neighbouring screen columns at once, 4 with SSE2 and 8 with AVX2. Every
+ * operation is done in the same order as the scalar code so the results come
+ * out exactly the same, which means the scalar code can be used to check them. */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+/* GCC and Clang will only let us use the newer instructions inside of functions
+ * that have been marked for them. Visual Studio lets us use them anywhere. */
+#if defined(__GNUC__) || defined(__clang__)
+#define RAY_TARGET_SSE2                 __attribute__((target("sse2")))
+#define RAY_TARGET_AVX2                 __attribute__((target("avx2")))
+#else
+#define RAY_TARGET_SSE2
+#define RAY_TARGET_AVX2
+#endif
+
+#define RAY_SSE2_LANES                  (4)
+#define RAY_AVX2_LANES                  (8)
+
+/* Pick a where the mask is set and b everywhere else. */
+RAY_TARGET_SSE2 static __m128 ray_select_sse2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+RAY_TARGET_SSE2 static __m128i ray_select_sse2_epi32(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* SSE2 has no floor instruction so build it out of a truncation. */
+RAY_TARGET_SSE2 static __m128 ray_floor_sse2(__m128 v) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    __m128 big;
+
+    /* Truncating rounds negative numbers up so pull those back down by one. */
+    t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), one));
+    /* Keep the sign so that -0 stays -0 the same way that floorf does it. */
+    t = _mm_or_ps(t, _mm_and_ps(v, sign));
+    /* Anything this big is already a whole number so leave it alone. */
+    big = _mm_cmpge_ps(_mm_andnot_ps(sign, v), _mm_set1_ps(8388608.0f));
+    return ray_select_sse2(big, v, t);
+}
+
+/* How many blocks around the one that the camera is in are known to be empty. */
+static int ray_start_reach(const ray_world* world, int start_x, int start_y) {
+    if (world->distance == NULL || start_x < 0 || start_y < 0 || start_x >= world->map_width || start_y >= world->map_height)
+        return 0;
+    return world->distance[MAP_INDEX(world->tiles_x, start_x, start_y)] - 1;
+}
+
+/* How far along the rays the next side is after a number of steps, see RAY_SIDE_DIST. */
+RAY_TARGET_SSE2 static __m128 ray_side_dist_sse2(__m128 first, __m128i steps, __m128 delta) {
+    return _mm_add_ps(first, _mm_mul_ps(_mm_cvtepi32_ps(steps), delta));
+}
+
+/* The same as ray_skip in ray.c for every lane in jump. The search for how many steps
+ * to take in the other direction runs until the slowest lane has found it. */
+RAY_TARGET_SSE2 static void ray_skip_sse2(__m128i jump, __m128i reach, __m128 first_x, __m128 delta_x, __m128 first_y, __m128 delta_y,
+    __m128 max_distance, __m128i* steps_x, __m128i* steps_y, __m128i* side) {
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i end_x = _mm_add_epi32(*steps_x, reach);
+    __m128i end_y = _mm_add_epi32(*steps_y, reach);
+    __m128 exit_x = ray_side_dist_sse2(first_x, end_x, delta_x);
+    __m128 exit_y = ray_side_dist_sse2(first_y, end_y, delta_y);
+    __m128 leave_x = _mm_cmplt_ps(exit_x, exit_y);
+    __m128 first = ray_select_sse2(leave_x, first_y, first_x);
+    __m128 delta = ray_select_sse2(leave_x, delta_y, delta_x);
+    __m128 limit = ray_select_sse2(leave_x, exit_x, exit_y);
+    __m128i low = ray_select_sse2_epi32(_mm_castps_si128(leave_x), *steps_y, *steps_x);
+    __m128i high = _mm_add_epi32(low, reach);
+    __m128i searching = _mm_and_si128(jump, _mm_cmplt_epi32(low, high));
+    __m128i new_x, new_y, on_y, ok;
+    __m128 last_x, last_y, travelled;
+
+    while (_mm_movemask_ps(_mm_castsi128_ps(searching)) != 0) {
+        __m128i middle = _mm_srli_epi32(_mm_add_epi32(low, high), 1);
+        __m128 dist = ray_side_dist_sse2(first, middle, delta);
+        __m128i past = _mm_castps_si128(ray_select_sse2(leave_x, _mm_cmpgt_ps(dist, limit), _mm_cmpge_ps(dist, limit)));
+
+        high = ray_select_sse2_epi32(_mm_and_si128(past, searching), middle, high);
+        low = ray_select_sse2_epi32(_mm_andnot_si128(past, searching), _mm_add_epi32(middle, one), low);
+        searching = _mm_and_si128(searching, _mm_cmplt_epi32(low, high));
+    }
+    new_x = ray_select_sse2_epi32(_mm_castps_si128(leave_x), end_x, low);
+    new_y = ray_select_sse2_epi32(_mm_castps_si128(leave_x), low, end_y);
+
+    /* Which side the last step went through and whether it is still on the ray. */
+    last_x = ray_side_dist_sse2(first_x, _mm_sub_epi32(new_x, one), delta_x);
+    last_y = ray_side_dist_sse2(first_y, _mm_sub_epi32(new_y, one), delta_y);
+    on_y = _mm_andnot_si128(_mm_andnot_si128(_mm_castps_si128(_mm_cmplt_ps(last_x, last_y)), _mm_cmpgt_epi32(new_x, *steps_x)),
+        _mm_cmpgt_epi32(new_y, *steps_y));
+    travelled = ray_select_sse2(_mm_castsi128_ps(on_y), last_y, last_x);
+    ok = _mm_andnot_si128(_mm_castps_si128(_mm_cmpgt_ps(travelled, max_distance)), jump);
+
+    *steps_x = ray_select_sse2_epi32(ok, new_x, *steps_x);
+    *steps_y = ray_select_sse2_epi32(ok, new_y, *steps_y);
+    *side = ray_select_sse2_epi32(ok, _mm_and_si128(on_y, one), *side);
+}
+
+RAY_TARGET_SSE2 void ray_cast_sse2(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 never = _mm_set1_ps(RAY_NEVER);
+    const __m128 camera_x = _mm_set1_ps(camera->x);
+    const __m128 camera_y = _mm_set1_ps(camera->y);
+    const __m128 width_f = _mm_set1_ps((float)(width));
+    const __m128 height_f = _mm_set1_ps((float)(height));
+    const __m128 max_distance = _mm_set1_ps(world->max_distance);
+    const __m128i last_x = _mm_set1_epi32(world->map_width - 1);
+    const __m128i last_y = _mm_set1_epi32(world->map_height - 1);
+    /* All of the rays start in the same block so the distance to the edges of
+     * that block is the same for every ray. */
+    const int start_x = (int)camera->x;
+    const int start_y = (int)camera->y;
+    const __m128 near_x = _mm_set1_ps(camera->x - start_x);
+    const __m128 far_x = _mm_set1_ps(start_x + 1.0f - camera->x);
+    const __m128 near_y = _mm_set1_ps(camera->y - start_y);
+    const __m128 far_y = _mm_set1_ps(start_y + 1.0f - camera->y);
+    /* The same goes for how much empty space there is around that block. */
+    const int start_reach = ray_start_reach(world, start_x, start_y);
+    int x, lane;
+
+    for (x = begin; x < end; x += RAY_SSE2_LANES) {
+        __m128i lane_x = _mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3));
+        __m128 x_in_camera = _mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(_mm_add_epi32(lane_x, lane_x)), width_f), one);
+        __m128 ray_dir_x = _mm_add_ps(_mm_set1_ps(camera->dir_x), _mm_mul_ps(_mm_set1_ps(camera->plane_x), x_in_camera));
+        __m128 ray_dir_y = _mm_add_ps(_mm_set1_ps(camera->dir_y), _mm_mul_ps(_mm_set1_ps(camera->plane_y), x_in_camera));
+        __m128 zero_x = _mm_cmpeq_ps(ray_dir_x, zero);
+        __m128 zero_y = _mm_cmpeq_ps(ray_dir_y, zero);
+        __m128 neg_x = _mm_cmplt_ps(ray_dir_x, zero);
+        __m128 neg_y = _mm_cmplt_ps(ray_dir_y, zero);
+        __m128 delta_dist_x, delta_dist_y, side_dist_x, side_dist_y;
+        __m128 perp_wall_dist, wall_x;
+        __m128i map_x = _mm_set1_epi32(start_x);
+        __m128i map_y = _mm_set1_epi32(start_y);
+        /* An all ones mask is -1 so or in a 1 to get the step of -1 or 1. */
+        __m128i step_x = _mm_or_si128(_mm_castps_si128(neg_x), _mm_set1_epi32(1));
+        __m128i step_y = _mm_or_si128(_mm_castps_si128(neg_y), _mm_set1_epi32(1));
+        __m128i side = _mm_setzero_si128();
+        __m128i steps_x = _mm_setzero_si128();
+        __m128i steps_y = _mm_setzero_si128();
+        __m128i side_y, line_height;
+        int active = 0xF;
+        int count = end - x < RAY_SSE2_LANES ? end - x : RAY_SSE2_LANES;
+        int cells_x[RAY_SSE2_LANES], cells_y[RAY_SSE2_LANES], sides[RAY_SSE2_LANES], heights[RAY_SSE2_LANES];
+        int cells[RAY_SSE2_LANES] = { 0, 0, 0, 0 };
+        int reach[RAY_SSE2_LANES] = { start_reach, start_reach, start_reach, start_reach };
+        float out_dir_x[RAY_SSE2_LANES], out_dir_y[RAY_SSE2_LANES], out_perp[RAY_SSE2_LANES];
+        float out_wall_x[RAY_SSE2_LANES];
+
+        /* Same special case as the scalar code, picked per lane. The division by zero
+         * in those lanes gives an infinity that gets thrown away. */
+        delta_dist_x = ray_select_sse2(zero_x, never, _mm_and_ps(abs_mask, _mm_div_ps(one, ray_dir_x)));
+        delta_dist_y = ray_select_sse2(zero_y, never, _mm_and_ps(abs_mask, _mm_div_ps(one, ray_dir_y)));
+        side_dist_x = _mm_mul_ps(ray_select_sse2(neg_x, near_x, far_x), delta_dist_x);
+        side_dist_y = _mm_mul_ps(ray_select_sse2(neg_y, near_y, far_y), delta_dist_y);
+
+        /* Step every lane that has not found a wall yet until they all have. Lanes that
+         * are finished keep their state and just come along for the ride. */
+        while (active != 0) {
+            __m128i lanes = _mm_setr_epi32(-(active & 1), -((active >> 1) & 1), -((active >> 2) & 1), -((active >> 3) & 1));
+            __m128i jump = _mm_and_si128(lanes, _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)reach), _mm_setzero_si128()));
+            __m128 next_x, next_y, less, take_x, take_y, travelled;
+            __m128i outside;
+            int stop;
+
+            /* Lanes with empty space around them skip over as much of it as they can. */
+            if (_mm_movemask_ps(_mm_castsi128_ps(jump)) != 0) {
+                ray_skip_sse2(jump, _mm_loadu_si128((const __m128i*)reach), side_dist_x, delta_dist_x, side_dist_y, delta_dist_y,
+                    max_distance, &steps_x, &steps_y, &side);
+                /* Flipping the bits and adding one is the same as multiplying by the step of -1. */
+                map_x = _mm_add_epi32(_mm_set1_epi32(start_x), _mm_sub_epi32(_mm_xor_si128(steps_x, _mm_castps_si128(neg_x)), _mm_castps_si128(neg_x)));
+                map_y = _mm_add_epi32(_mm_set1_epi32(start_y), _mm_sub_epi32(_mm_xor_si128(steps_y, _mm_castps_si128(neg_y)), _mm_castps_si128(neg_y)));
+            }
+
+            next_x = ray_side_dist_sse2(side_dist_x, steps_x, delta_dist_x);
+            next_y = ray_side_dist_sse2(side_dist_y, steps_y, delta_dist_y);
+            less = _mm_cmplt_ps(next_x, next_y);
+            take_x = _mm_and_ps(less, _mm_castsi128_ps(lanes));
+            take_y = _mm_andnot_ps(less, _mm_castsi128_ps(lanes));
+            travelled = ray_select_sse2(less, next_x, next_y);
+
+            /* A mask is -1 so taking it away adds one step. */
+            steps_x = _mm_sub_epi32(steps_x, _mm_castps_si128(take_x));
+            steps_y = _mm_sub_epi32(steps_y, _mm_castps_si128(take_y));
+            map_x = _mm_add_epi32(map_x, _mm_and_si128(step_x, _mm_castps_si128(take_x)));
+            map_y = _mm_add_epi32(map_y, _mm_and_si128(step_y, _mm_castps_si128(take_y)));
+            side = ray_select_sse2_epi32(lanes, _mm_and_si128(_mm_castps_si128(take_y), _mm_set1_epi32(1)), side);
+
+            /* Lanes that left the map or went too far are done without a wall. */
+            outside = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(map_x, _mm_setzero_si128()), _mm_cmpgt_epi32(map_x, last_x)),
+                _mm_or_si128(_mm_cmplt_epi32(map_y, _mm_setzero_si128()), _mm_cmpgt_epi32(map_y, last_y)));
+            stop = _mm_movemask_ps(_mm_or_ps(_mm_castsi128_ps(outside), _mm_cmpgt_ps(travelled, max_distance)));
+            active &= ~stop;
+
+            /* There is no gather in SSE2 so look up the blocks one lane at a time. */
+            _mm_storeu_si128((__m128i*)cells_x, map_x);
+            _mm_storeu_si128((__m128i*)cells_y, map_y);
+            for (lane = 0; lane < RAY_SSE2_LANES; lane++) {
+                if (active & (1 << lane)) {
+                    int index = MAP_INDEX(world->tiles_x, cells_x[lane], cells_y[lane]);
+                    int cell;
+
+                    if (world->distance != NULL) {
+                        reach[lane] = world->distance[index] - 1;
+                        cell = reach[lane] < 0 ? world->cells[index] : 0;
+                    } else {
+                        cell = world->cells[index];
+                    }
+                    if (cell > 0) {
+                        cells[lane] = cell;
+                        active &= ~(1 << lane);
+                    }
+                }
+            }
+        }
+
+        /* Work out the distance for both kinds of side and keep the one that was hit. */
+        side_y = _mm_cmpeq_epi32(side, _mm_set1_epi32(1));
+        perp_wall_dist = ray_select_sse2(_mm_castsi128_ps(side_y),
+            _mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_cvtepi32_ps(map_y), camera_y), _mm_and_ps(neg_y, one)), ray_dir_y),
+            _mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_cvtepi32_ps(map_x), camera_x), _mm_and_ps(neg_x, one)), ray_dir_x));
+
+        wall_x = ray_select_sse2(_mm_castsi128_ps(side_y),
+            _mm_add_ps(camera_x, _mm_mul_ps(perp_wall_dist, ray_dir_x)),
+            _mm_add_ps(camera_y, _mm_mul_ps(perp_wall_dist, ray_dir_y)));
+        wall_x = _mm_sub_ps(wall_x, ray_floor_sse2(wall_x));
+
+        line_height = _mm_cvttps_epi32(_mm_div_ps(height_f, perp_wall_dist));
+
+        _mm_storeu_ps(out_dir_x, ray_dir_x);
+        _mm_storeu_ps(out_dir_y, ray_dir_y);
+        _mm_storeu_ps(out_perp, perp_wall_dist);
+        _mm_storeu_ps(out_wall_x, wall_x);
+        _mm_storeu_si128((__m128i*)cells_x, map_x);
+        _mm_storeu_si128((__m128i*)cells_y, map_y);
+        _mm_storeu_si128((__m128i*)sides, side);
+        _mm_storeu_si128((__m128i*)heights, line_height);
+
+        /* Only keep the lanes that are really on the screen. */
+        for (lane = 0; lane < count; lane++) {
+            ray_hit* hit_info = &hits[x - begin + lane];
+            hit_info->ray_dir_x = out_dir_x[lane];
+            hit_info->ray_dir_y = out_dir_y[lane];
+            hit_info->perp_wall_dist = out_perp[lane];
+            hit_info->wall_x = out_wall_x[lane];
+            hit_info->map_x = cells_x[lane];
+            hit_info->map_y = cells_y[lane];
+            hit_info->cell = cells[lane];
+            hit_info->side = sides[lane];
+            hit_info->line_height = heights[lane];
+        }
+    }
+}
+
+/* MAP_INDEX for every lane. */
+RAY_TARGET_AVX2 static __m256i ray_index_avx2(__m256i map_x, __m256i map_y, __m256i tiles_x) {
+    const __m256i tile_mask = _mm256_set1_epi32(MAP_TILE_MASK);
+    __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(map_y, MAP_TILE_SHIFT), tiles_x), _mm256_srai_epi32(map_x, MAP_TILE_SHIFT));
+
+    return _mm256_or_si256(_mm256_slli_epi32(index, 2 * MAP_TILE_SHIFT),
+        _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(map_y, tile_mask), MAP_TILE_SHIFT), _mm256_and_si256(map_x, tile_mask)));
+}
+
+RAY_TARGET_AVX2 static __m256 ray_side_dist_avx2(__m256 first, __m256i steps, __m256 delta) {
+    return _mm256_add_ps(first, _mm256_mul_ps(_mm256_cvtepi32_ps(steps), delta));
+}
+
+RAY_TARGET_AVX2 static void ray_skip_avx2(__m256i jump, __m256i reach, __m256 first_x, __m256 delta_x, __m256 first_y, __m256 delta_y,
+    __m256 max_distance, __m256i* steps_x, __m256i* steps_y, __m256i* side) {
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i end_x = _mm256_add_epi32(*steps_x, reach);
+    __m256i end_y = _mm256_add_epi32(*steps_y, reach);
+    __m256 exit_x = ray_side_dist_avx2(first_x, end_x, delta_x);
+    __m256 exit_y = ray_side_dist_avx2(first_y, end_y, delta_y);
+    __m256 leave_x = _mm256_cmp_ps(exit_x, exit_y, _CMP_LT_OQ);
+    __m256 first = _mm256_blendv_ps(first_x, first_y, leave_x);
+    __m256 delta = _mm256_blendv_ps(delta_x, delta_y, leave_x);
+    __m256 limit = _mm256_blendv_ps(exit_y, exit_x, leave_x);
+    __m256i low = _mm256_blendv_epi8(*steps_x, *steps_y, _mm256_castps_si256(leave_x));
+    __m256i high = _mm256_add_epi32(low, reach);
+    __m256i searching = _mm256_and_si256(jump, _mm256_cmpgt_epi32(high, low));
+    __m256i new_x, new_y, on_y, ok;
+    __m256 last_x, last_y, travelled;
+
+    while (!_mm256_testz_si256(searching, searching)) {
+        __m256i middle = _mm256_srli_epi32(_mm256_add_epi32(low, high), 1);
+        __m256 dist = ray_side_dist_avx2(first, middle, delta);
+        __m256i past = _mm256_castps_si256(_mm256_blendv_ps(_mm256_cmp_ps(dist, limit, _CMP_GE_OQ), _mm256_cmp_ps(dist, limit, _CMP_GT_OQ), leave_x));
+
+        high = _mm256_blendv_epi8(high, middle, _mm256_and_si256(past, searching));
+        low = _mm256_blendv_epi8(low, _mm256_add_epi32(middle, one), _mm256_andnot_si256(past, searching));
+        searching = _mm256_and_si256(searching, _mm256_cmpgt_epi32(high, low));
+    }
+    new_x = _mm256_blendv_epi8(low, end_x, _mm256_castps_si256(leave_x));
+    new_y = _mm256_blendv_epi8(end_y, low, _mm256_castps_si256(leave_x));
+
+    last_x = ray_side_dist_avx2(first_x, _mm256_sub_epi32(new_x, one), delta_x);
+    last_y = ray_side_dist_avx2(first_y, _mm256_sub_epi32(new_y, one), delta_y);
+    on_y = _mm256_andnot_si256(_mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(last_x, last_y, _CMP_LT_OQ)), _mm256_cmpgt_epi32(new_x, *steps_x)),
+        _mm256_cmpgt_epi32(new_y, *steps_y));
+    travelled = _mm256_blendv_ps(last_x, last_y, _mm256_castsi256_ps(on_y));
+    ok = _mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(travelled, max_distance, _CMP_GT_OQ)), jump);
+
+    *steps_x = _mm256_blendv_epi8(*steps_x, new_x, ok);
+    *steps_y = _mm256_blendv_epi8(*steps_y, new_y, ok);
+    *side = _mm256_blendv_epi8(*side, _mm256_and_si256(on_y, one), ok);
+}
+
+RAY_TARGET_AVX2 void ray_cast_avx2(const ray_camera* camera, const ray_world* world,
+    int width, int height, int begin, int end, ray_hit* hits) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 never = _mm256_set1_ps(RAY_NEVER);
+    const __m256 camera_x = _mm256_set1_ps(camera->x);
+    const __m256 camera_y = _mm256_set1_ps(camera->y);
+    const __m256 width_f = _mm256_set1_ps((float)(width));
+    const __m256 height_f = _mm256_set1_ps((float)(height));
+    const __m256 max_distance = _mm256_set1_ps(world->max_distance);
+    const __m256i last_x = _mm256_set1_epi32(world->map_width - 1);
+    const __m256i last_y = _mm256_set1_epi32(world->map_height - 1);
+    const __m256i tiles_x = _mm256_set1_epi32(world->tiles_x);
+    /* All of the rays start in the same block so the distance to the edges of
+     * that block is the same for every ray. */
+    const int start_x = (int)camera->x;
+    const int start_y = (int)camera->y;
+    const __m256 near_x = _mm256_set1_ps(camera->x - start_x);
+    const __m256 far_x = _mm256_set1_ps(start_x + 1.0f - camera->x);
+    const __m256 near_y = _mm256_set1_ps(camera->y - start_y);
+    const __m256 far_y = _mm256_set1_ps(start_y + 1.0f - camera->y);
+    const int start_reach = ray_start_reach(world, start_x, start_y);
+    int x, lane;
+
+    for (x = begin; x < end; x += RAY_AVX2_LANES) {
+        __m256i lane_x = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256 x_in_camera = _mm256_sub_ps(_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(lane_x, lane_x)), width_f), one);
+        __m256 ray_dir_x = _mm256_add_ps(_mm256_set1_ps(camera->dir_x), _mm256_mul_ps(_mm256_set1_ps(camera->plane_x), x_in_camera));
+        __m256 ray_dir_y = _mm256_add_ps(_mm256_set1_ps(camera->dir_y), _mm256_mul_ps(_mm256_set1_ps(camera->plane_y), x_in_camera));
+        __m256 zero_x = _mm256_cmp_ps(ray_dir_x, zero, _CMP_EQ_OQ);
+        __m256 zero_y = _mm256_cmp_ps(ray_dir_y, zero, _CMP_EQ_OQ);
+        __m256 neg_x = _mm256_cmp_ps(ray_dir_x, zero, _CMP_LT_OQ);
+        __m256 neg_y = _mm256_cmp_ps(ray_dir_y, zero, _CMP_LT_OQ);
+        __m256 delta_dist_x, delta_dist_y, side_dist_x, side_dist_y;
+        __m256 perp_wall_dist, wall_x, side_y;
+        __m256i map_x = _mm256_set1_epi32(start_x);
+        __m256i map_y = _mm256_set1_epi32(start_y);
+        /* An all ones mask is -1 so or in a 1 to get the step of -1 or 1. */
+        __m256i step_x = _mm256_or_si256(_mm256_castps_si256(neg_x), _mm256_set1_epi32(1));
+        __m256i step_y = _mm256_or_si256(_mm256_castps_si256(neg_y), _mm256_set1_epi32(1));
+        __m256i side = _mm256_setzero_si256();
+        __m256i steps_x = _mm256_setzero_si256();
+        __m256i steps_y = _mm256_setzero_si256();
+        __m256i reach = _mm256_set1_epi32(start_reach);
+        __m256i active = _mm256_set1_epi32(-1);
+        __m256i solid = _mm256_setzero_si256();
+        __m256i cell = _mm256_setzero_si256();
+        __m256i index, line_height;
+        int count = end - x < RAY_AVX2_LANES ? end - x : RAY_AVX2_LANES;
+        int cells_x[RAY_AVX2_LANES], cells_y[RAY_AVX2_LANES], sides[RAY_AVX2_LANES], heights[RAY_AVX2_LANES];
+        int cells[RAY_AVX2_LANES];
+        float out_dir_x[RAY_AVX2_LANES], out_dir_y[RAY_AVX2_LANES], out_perp[RAY_AVX2_LANES];
+        float out_wall_x[RAY_AVX2_LANES];
+
+        /* Same special case as the scalar code, picked per lane. */
+        delta_dist_x = _mm256_blendv_ps(_mm256_and_ps(abs_mask, _mm256_div_ps(one, ray_dir_x)), never, zero_x);
+        delta_dist_y = _mm256_blendv_ps(_mm256_and_ps(abs_mask, _mm256_div_ps(one, ray_dir_y)), never, zero_y);
+        side_dist_x = _mm256_mul_ps(_mm256_blendv_ps(far_x, near_x, neg_x), delta_dist_x);
+        side_dist_y = _mm256_mul_ps(_mm256_blendv_ps(far_y, near_y, neg_y), delta_dist_y);
+
+        /* Step every lane that has not found a wall yet until they all have. */
+        while (!_mm256_testz_si256(active, active)) {
+            __m256i jump = _mm256_and_si256(active, _mm256_cmpgt_epi32(reach, _mm256_setzero_si256()));
+            __m256 next_x, next_y, less, take_x, take_y, travelled;
+            __m256i outside, found;
+
+            if (!_mm256_testz_si256(jump, jump)) {
+                ray_skip_avx2(jump, reach, side_dist_x, delta_dist_x, side_dist_y, delta_dist_y, max_distance, &steps_x, &steps_y, &side);
+                map_x = _mm256_add_epi32(_mm256_set1_epi32(start_x), _mm256_sign_epi32(steps_x, step_x));
+                map_y = _mm256_add_epi32(_mm256_set1_epi32(start_y), _mm256_sign_epi32(steps_y, step_y));
+            }
+
+            next_x = ray_side_dist_avx2(side_dist_x, steps_x, delta_dist_x);
+            next_y = ray_side_dist_avx2(side_dist_y, steps_y, delta_dist_y);
+            less = _mm256_cmp_ps(next_x, next_y, _CMP_LT_OQ);
+            take_x = _mm256_and_ps(less, _mm256_castsi256_ps(active));
+            take_y = _mm256_andnot_ps(less, _mm256_castsi256_ps(active));
+            travelled = _mm256_blendv_ps(next_y, next_x, less);
+
+            steps_x = _mm256_sub_epi32(steps_x, _mm256_castps_si256(take_x));
+            steps_y = _mm256_sub_epi32(steps_y, _mm256_castps_si256(take_y));
+            map_x = _mm256_add_epi32(map_x, _mm256_and_si256(step_x, _mm256_castps_si256(take_x)));
+            map_y = _mm256_add_epi32(map_y, _mm256_and_si256(step_y, _mm256_castps_si256(take_y)));
+            side = _mm256_blendv_epi8(side, _mm256_and_si256(_mm256_castps_si256(take_y), _mm256_set1_epi32(1)), active);
+
+            /* Lanes that left the map or went too far are done without a wall. */
+            outside = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), map_x), _mm256_cmpgt_epi32(map_x, last_x)),
+                _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), map_y), _mm256_cmpgt_epi32(map_y, last_y)));
+            outside = _mm256_or_si256(outside, _mm256_castps_si256(_mm256_cmp_ps(travelled, max_distance, _CMP_GT_OQ)));
+            active = _mm256_andnot_si256(outside, active);
+
+            /* Work out where each block is in the tiles and only look up the lanes that
+             * are still going. The gather reads four bytes at a time so the padding after
+             * the map keeps the last block safe to read. With a distance field that is
+             * all we look at until a lane hits something. */
+            index = ray_index_avx2(map_x, map_y, tiles_x);
+            if (world->distance != NULL) {
+                found = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)world->distance, index, active, 1);
+                reach = _mm256_sub_epi32(_mm256_and_si256(found, _mm256_set1_epi32(0xFF)), _mm256_set1_epi32(1));
+                found = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), reach), active);
+                solid = _mm256_or_si256(solid, found);
+            } else {
+                found = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)world->cells, index, active, 1);
+                found = _mm256_and_si256(found, _mm256_set1_epi32(0xFF));
+                found = _mm256_and_si256(_mm256_cmpgt_epi32(found, _mm256_setzero_si256()), active);
+                solid = _mm256_or_si256(solid, found);
+            }
+            active = _mm256_andnot_si256(found, active);
+        }
+
+        /* Find out what the lanes that hit something actually hit. */
+        index = ray_index_avx2(map_x, map_y, tiles_x);
+        cell = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)world->cells, index, solid, 1);
+        cell = _mm256_and_si256(cell, _mm256_set1_epi32(0xFF));
+
+        /* Work out the distance for both kinds of side and keep the one that was hit. */
+        side_y = _mm256_castsi256_ps(_mm256_cmpeq_epi32(side, _mm256_set1_epi32(1)));
+        perp_wall_dist = _mm256_blendv_ps(
+            _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(map_x), camera_x), _mm256_and_ps(neg_x, one)), ray_dir_x),
+            _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(map_y), camera_y), _mm256_and_ps(neg_y, one)), ray_dir_y),
+            side_y);
+
+        wall_x = _mm256_blendv_ps(
+            _mm256_add_ps(camera_y, _mm256_mul_ps(perp_wall_dist, ray_dir_y)),
+            _mm256_add_ps(camera_x, _mm256_mul_ps(perp_wall_dist, ray_dir_x)),
+            side_y);
+        wall_x = _mm256_sub_ps(wall_x, _mm256_floor_ps(wall_x));
+
+        line_height = _mm256_cvttps_epi32(_mm256_div_ps(height_f, perp_wall_dist));
+
+        _mm256_storeu_ps(out_dir_x, ray_dir_x);
+        _mm256_storeu_ps(out_dir_y, ray_dir_y);
+        _mm256_storeu_ps(out_perp, perp_wall_dist);
+        _mm256_storeu_ps(out_wall_x, wall_x);
+        _mm256_storeu_si256((__m256i*)cells_x, map_x);
+        _mm256_storeu_si256((__m256i*)cells_y, map_y);
+        _mm256_storeu_si256((__m256i*)sides, side);
+        _mm256_storeu_si256((__m256i*)cells, cell);
+        _mm256_storeu_si256((__m256i*)heights, line_height);
+
+        /* Only keep the lanes that are really on the screen. */
+        for (lane = 0; lane < count; lane++) {
+            ray_hit* hit_info = &hits[x - begin + lane];
+            hit_info->ray_dir_x = out_dir_x[lane];
+            hit_info->ray_dir_y = out_dir_y[lane];
+            hit_info->perp_wall_dist = out_perp[lane];
+            hit_info->wall_x = out_wall_x[lane];
+            hit_info->map_x = cells_x[lane];
+            hit_info->map_y = cells_y[lane];
+            hit_info->cell = cells[lane];
+            hit_info->side = sides[lane];
+            hit_info->line_height = heights[lane];
+        }
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "res.h"
+
+static float res_budget = 0.0f;
+static float res_average = 0.0f;
+static int res_settle = 0;
+static int res_max_width = 0, res_max_height = 0;
+static int res_min_width = 0, res_min_height = 0;
+static int res_step_width = 1, res_step_height = 1;
+static int res_width = 0, res_height = 0;
+
+void res_init(int max_width, int max_height, float budget) {
+    res_max_width = max_width;
+    res_max_height = max_height;
+    res_min_width = (int)((float)max_width * RES_MIN_SCALE);
+    res_min_height = (int)((float)max_height * RES_MIN_SCALE);
+    res_step_width = (int)((float)max_width * RES_STEP_SCALE);
+    res_step_height = (int)((float)max_height * RES_STEP_SCALE);
+    if (res_step_width < 1)
+        res_step_width = 1;
+    if (res_step_height < 1)
+        res_step_height = 1;
+    res_width = max_width;
+    res_height = max_height;
+    res_budget = budget;
+    res_average = 0.0f;
+    res_settle = 0;
+}
+
+void res_update(float draw_time) {
+    /* Smooth the time out a little so that one slow frame does not set it off. */
+    if (res_average == 0.0f)
+        res_average = draw_time;
+    else
+        res_average = res_average * 0.9f + draw_time * 0.1f;
+
+    if (res_settle > 0) {
+        res_settle--;
+        return;
+    }
+
+    if (res_average > res_budget * RES_HIGH_WATER) {
+        /* Columns go first since every one of them is a ray, a slice of wall and a slice
+         * of every sprite, where a row is only a stretch of floor or ceiling. */
+        if (res_width > res_min_width)
+            res_width -= res_step_width;
+        else if (res_height > res_min_height)
+            res_height -= res_step_height;
+        else
+            return;
+    } else if (res_average < res_budget * RES_LOW_WATER) {
+        /* Give back what was taken away last first. */
+        if (res_height < res_max_height)
+            res_height += res_step_height;
+        else if (res_width < res_max_width)
+            res_width += res_step_width;
+        else
+            return;
+    } else {
+        return;
+    }
+
+    if (res_width < res_min_width)
+        res_width = res_min_width;
+    if (res_width > res_max_width)
+        res_width = res_max_width;
+    if (res_height < res_min_height)
+        res_height = res_min_height;
+    if (res_height > res_max_height)
+        res_height = res_max_height;
+    /* Start over judging the new size from scratch. */
+    res_average = 0.0f;
+    res_settle = RES_SETTLE_FRAMES;
+}
+
+int res_get_width(void) {
+    return res_width;
+}
+
+int res_get_height(void) {
+    return res_height;
+}
\ No newline at end of file
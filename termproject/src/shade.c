@@ -0,0 +1,69 @@
+#include "shade.h"
+
+#define SHADE_DISTANCES                 (SHADE_MAX_DISTANCE * SHADE_DISTANCE_STEPS)
+
+/* Rather than multiplying every texel by a float we only have a few levels of light
+ * and work out what every channel value turns into at each of them up front. Each
+ * level's table is 256 bytes so the one a wall is using stays in the cache. */
+static unsigned char shade_tables[SHADE_LEVELS][256];
+/* Which level things are lit at for each step of distance from the camera. */
+static unsigned char shade_distances[SHADE_DISTANCES];
+static float shade_max_light = 0.0f;
+
+void shade_set_max_light(float max_light) {
+    int level, channel, i;
+
+    /* The channel tables never change but there is no harm in filling them in again. */
+    for (level = 0; level < SHADE_LEVELS; level++) {
+        for (channel = 0; channel < 256; channel++)
+            shade_tables[level][channel] = (unsigned char)(channel * level / (SHADE_LEVELS - 1));
+    }
+
+    /* Things get darker the further away they are until they fade out completely
+     * at the max light distance. */
+    if (max_light <= 0.0f)
+        max_light = SHADE_DEFAULT_MAX_LIGHT;
+    for (i = 0; i < SHADE_DISTANCES; i++) {
+        float light = 1.0f - ((float)i / SHADE_DISTANCE_STEPS) / max_light;
+        if (light < 0.0f)
+            light = 0.0f;
+        if (light > 1.0f)
+            light = 1.0f;
+        shade_distances[i] = (unsigned char)(light * (SHADE_LEVELS - 1) + 0.5f);
+    }
+    shade_max_light = max_light;
+}
+
+float shade_get_max_light(void) {
+    return shade_max_light;
+}
+
+int shade_get_level(float distance) {
+    /* Written so that NaN ends up black along with everything that is too far away. */
+    if (!(distance < SHADE_MAX_DISTANCE))
+        return 0;
+    if (distance < 0.0f)
+        distance = 0.0f;
+    return shade_distances[(int)(distance * SHADE_DISTANCE_STEPS)];
+}
+
+int shade_get_level_fixed(fixed distance) {
+    if (distance >= FIXED_FROM_INT(SHADE_MAX_DISTANCE))
+        return 0;
+    if (distance < 0)
+        distance = 0;
+    return shade_distances[(distance * SHADE_DISTANCE_STEPS) >> FIXED_SHIFT];
+}
+
+const unsigned char* shade_get_table(int level) {
+    if (level < 0)
+        level = 0;
+    if (level >= SHADE_LEVELS)
+        level = SHADE_LEVELS - 1;
+    return shade_tables[level];
+}
+
+gfx_color shade_color(gfx_color color, int level) {
+    const unsigned char* table = shade_get_table(level);
+    return SHADE_COLOR(table, color);
+}
\ No newline at end of file
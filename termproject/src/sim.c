@@ -0,0 +1,232 @@
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include "demo.h"
+#include "map.h"
+#include "prof.h"
+#include "sim.h"
+
+#define SIM_KEYS                        (DEMO_INPUTS)
+/* The shared slot of the triple buffer is kept in the low bits and the high bit
+ * says whether the writer has put something in it since the reader last looked. */
+#define SIM_INDEX                       (3)
+#define SIM_FRESH                       (4)
+
+/* Everything the renderer needs to know about one step of the simulation. The
+ * camera from the step before is kept with it so that frames drawn in between
+ * two steps can blend from one to the other. */
+typedef struct {
+    ray_camera previous;
+    ray_camera current;
+    /* When the current step was due, in performance counter ticks. */
+    Uint64 time;
+    /* The keys that the current step was taken with. */
+    int keys[SIM_KEYS];
+} sim_snapshot;
+
+/* Three snapshots means the simulation always has one to write into, the renderer
+ * always has one to read from and the newest finished one sits in between. Neither
+ * side ever waits on the other, they just swap their own slot with the middle one. */
+static sim_snapshot sim_snapshots[3];
+static SDL_atomic_t sim_shared;
+static int sim_back = 0;
+static int sim_front = 2;
+
+static SDL_atomic_t sim_keys[SIM_KEYS];
+static SDL_atomic_t sim_quit;
+static SDL_Thread* sim_thread = NULL;
+/* Held for the whole of every step, so that the map can be changed in between them. */
+static SDL_mutex* sim_lock = NULL;
+static Uint64 sim_step_ticks = 1;
+/* Only the renderer looks at these. Which keys it saw held last time and when it
+ * first saw each of them change, which is where moving ahead for them starts from. */
+static int sim_seen_keys[SIM_KEYS];
+static Uint64 sim_change_times[SIM_KEYS];
+
+static int sim_run(void* data) {
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 next = SDL_GetPerformanceCounter();
+    ray_camera previous;
+    int keys[SIM_KEYS];
+    int i;
+
+    (void)data;
+    PROF_THREAD("sim");
+    demo_get_camera(&previous);
+
+    while (!SDL_AtomicGet(&sim_quit)) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        sim_snapshot* snapshot;
+
+        /* Give the time back until the next step is due. */
+        if (now < next) {
+            SDL_Delay((Uint32)((next - now) * 1000 / freq));
+            continue;
+        }
+        /* After a long stall it is better to skip ahead than to run a burst of steps. */
+        if (now - next > sim_step_ticks * SIM_MAX_CATCH_UP)
+            next = now;
+
+        for (i = 0; i < SIM_KEYS; i++)
+            keys[i] = SDL_AtomicGet(&sim_keys[i]);
+        {
+            PROF_BEGIN(tick);
+            SDL_LockMutex(sim_lock);
+            demo_tick(SIM_STEP, keys);
+            SDL_UnlockMutex(sim_lock);
+            PROF_END(tick, "demo_tick");
+        }
+
+        /* Fill in our own slot and then swap it into the middle for the renderer. */
+        snapshot = &sim_snapshots[sim_back];
+        snapshot->previous = previous;
+        demo_get_camera(&snapshot->current);
+        snapshot->time = next;
+        for (i = 0; i < SIM_KEYS; i++)
+            snapshot->keys[i] = keys[i];
+        previous = snapshot->current;
+        sim_back = SDL_AtomicSet(&sim_shared, sim_back | SIM_FRESH) & SIM_INDEX;
+
+        next += sim_step_ticks;
+    }
+    return 0;
+}
+
+int sim_start(void) {
+    ray_camera camera;
+    int i;
+
+    sim_step_ticks = SDL_GetPerformanceFrequency() / SIM_TICK_RATE;
+    if (sim_step_ticks == 0)
+        sim_step_ticks = 1;
+
+    /* Until the first step is done every slot just holds where the camera starts. */
+    demo_get_camera(&camera);
+    for (i = 0; i < 3; i++) {
+        sim_snapshots[i].previous = camera;
+        sim_snapshots[i].current = camera;
+        sim_snapshots[i].time = SDL_GetPerformanceCounter();
+        memset(sim_snapshots[i].keys, 0, sizeof(sim_snapshots[i].keys));
+    }
+    sim_back = 0;
+    sim_front = 2;
+    SDL_AtomicSet(&sim_shared, 1);
+    for (i = 0; i < SIM_KEYS; i++) {
+        SDL_AtomicSet(&sim_keys[i], 0);
+        sim_seen_keys[i] = 0;
+        sim_change_times[i] = 0;
+    }
+    SDL_AtomicSet(&sim_quit, 0);
+
+    sim_lock = SDL_CreateMutex();
+    if (sim_lock == NULL)
+        return -1;
+    sim_thread = SDL_CreateThread(sim_run, "sim", NULL);
+    return sim_thread != NULL ? 0 : -1;
+}
+
+void sim_stop(void) {
+    if (sim_thread != NULL) {
+        SDL_AtomicSet(&sim_quit, 1);
+        SDL_WaitThread(sim_thread, NULL);
+        sim_thread = NULL;
+    }
+    if (sim_lock != NULL)
+        SDL_DestroyMutex(sim_lock);
+    sim_lock = NULL;
+}
+
+/* Puts in any changes to the map that the steps have queued up. Nothing can be drawing
+ * while this is called, and the steps get held off until it is done. */
+void sim_apply_edits(void) {
+    /* Most of the time there is nothing to do and no reason to hold up a step. */
+    if (map_get_edit_count() == 0)
+        return;
+    SDL_LockMutex(sim_lock);
+    map_apply_edits();
+    SDL_UnlockMutex(sim_lock);
+}
+
+void sim_set_keys(const int* keys) {
+    int i;
+
+    for (i = 0; i < SIM_KEYS; i++)
+        SDL_AtomicSet(&sim_keys[i], keys[i]);
+}
+
+/* Scales a vector blended between two others back up to the length of the second
+ * one, blending two directions a little apart makes one that is a little short. */
+static void sim_rescale(float* x, float* y, float to_x, float to_y) {
+    float length = sqrtf(*x * *x + *y * *y);
+
+    if (length > 0.0f) {
+        float scale = sqrtf(to_x * to_x + to_y * to_y) / length;
+        *x *= scale;
+        *y *= scale;
+    }
+}
+
+void sim_get_camera(ray_camera* camera) {
+    const sim_snapshot* snapshot;
+    Uint64 now;
+    float blend;
+    int i;
+
+    /* Only swap with the middle slot if there is something new in it, otherwise we
+     * would get back the old one that we gave up last time. */
+    if (SDL_AtomicGet(&sim_shared) & SIM_FRESH)
+        sim_front = SDL_AtomicSet(&sim_shared, sim_front) & SIM_INDEX;
+    snapshot = &sim_snapshots[sim_front];
+
+    /* Draw the world as it was a step ago and move towards the newest step as the
+     * time for the next one comes up. That way motion is smooth no matter how the
+     * frames line up with the steps. */
+    now = SDL_GetPerformanceCounter();
+    blend = 0.0f;
+    if (now > snapshot->time)
+        blend = (float)((double)(now - snapshot->time) / (double)sim_step_ticks);
+    if (blend > 1.0f)
+        blend = 1.0f;
+
+    camera->x = snapshot->previous.x + (snapshot->current.x - snapshot->previous.x) * blend;
+    camera->y = snapshot->previous.y + (snapshot->current.y - snapshot->previous.y) * blend;
+    camera->dir_x = snapshot->previous.dir_x + (snapshot->current.dir_x - snapshot->previous.dir_x) * blend;
+    camera->dir_y = snapshot->previous.dir_y + (snapshot->current.dir_y - snapshot->previous.dir_y) * blend;
+    camera->plane_x = snapshot->previous.plane_x + (snapshot->current.plane_x - snapshot->previous.plane_x) * blend;
+    camera->plane_y = snapshot->previous.plane_y + (snapshot->current.plane_y - snapshot->previous.plane_y) * blend;
+    sim_rescale(&camera->dir_x, &camera->dir_y, snapshot->current.dir_x, snapshot->current.dir_y);
+    sim_rescale(&camera->plane_x, &camera->plane_y, snapshot->current.plane_x, snapshot->current.plane_y);
+
+    /* Blending leaves the picture a step behind the keys, so on top of it the keys
+     * held right at this moment move the camera ahead. A key that was just pressed
+     * starts to show in the very next frame instead of a step or two later. A key
+     * that the newest step was already taken with is a whole step ahead. One that
+     * was pressed since grows from nothing up to a whole step by the time the next
+     * step comes in, and one that was let go shrinks back to nothing by then, which
+     * is where the simulation is going to stop. Nothing jumps when a step comes in. */
+    for (i = 0; i < SIM_KEYS; i++) {
+        int key[SIM_KEYS] = { 0 };
+        int held = SDL_AtomicGet(&sim_keys[i]);
+        float since = 0.0f, ahead = 0.0f;
+
+        if (held != sim_seen_keys[i]) {
+            sim_seen_keys[i] = held;
+            sim_change_times[i] = now;
+        }
+        if (sim_change_times[i] > snapshot->time)
+            since = (float)((double)(sim_change_times[i] - snapshot->time) / (double)sim_step_ticks);
+        if (since > blend)
+            since = blend;
+
+        if (held && snapshot->keys[i])
+            ahead = 1.0f;
+        else if (held)
+            ahead = since < 1.0f ? (blend - since) / (1.0f - since) : 1.0f;
+        else if (snapshot->keys[i])
+            ahead = since < 1.0f ? (1.0f - blend) / (1.0f - since) : 0.0f;
+
+        key[i] = 1;
+        if (ahead > 0.0f)
+            demo_move_camera(camera, SIM_STEP * ahead, key);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <string.h>
+#include "column.h"
+#include "sprite.h"
+
+/* Radix sorting the depths a byte at a time. */
+#define SPRITE_RADIX_BITS               (8)
+#define SPRITE_RADIX_SIZE               (1 << SPRITE_RADIX_BITS)
+
+/* The sprites are kept as a structure of arrays. Culling thousands of them only has
+ * to stream through the fields it actually needs, and the loop that moves them into
+ * camera space does the same maths on every element so it can be done a few at a time. */
+static int sprite_count = 0;
+static int sprite_capacity = 0;
+static float* sprite_x = NULL;
+static float* sprite_y = NULL;
+static int* sprite_bitmap = NULL;
+
+int sprite_init(int capacity) {
+    size_t n = capacity > 0 ? (size_t)capacity : 1;
+
+    sprite_free();
+    sprite_x = (float*)malloc(n * sizeof(float));
+    sprite_y = (float*)malloc(n * sizeof(float));
+    sprite_bitmap = (int*)malloc(n * sizeof(int));
+    if (sprite_x == NULL || sprite_y == NULL || sprite_bitmap == NULL) {
+        sprite_free();
+        return -1;
+    }
+    sprite_capacity = (int)n;
+    return 0;
+}
+
+void sprite_free(void) {
+    free(sprite_x);
+    free(sprite_y);
+    free(sprite_bitmap);
+    sprite_x = sprite_y = NULL;
+    sprite_bitmap = NULL;
+    sprite_count = 0;
+    sprite_capacity = 0;
+}
+
+void sprite_clear(void) {
+    sprite_count = 0;
+}
+
+int sprite_add(float x, float y, int bitmap) {
+    if (sprite_count >= sprite_capacity)
+        return -1;
+    sprite_x[sprite_count] = x;
+    sprite_y[sprite_count] = y;
+    sprite_bitmap[sprite_count] = bitmap;
+    return sprite_count++;
+}
+
+int sprite_get_count(void) {
+    return sprite_count;
+}
+
+int sprite_view_init(sprite_view* view) {
+    size_t n = sprite_capacity > 0 ? (size_t)sprite_capacity : 1;
+
+    memset(view, 0, sizeof(sprite_view));
+    view->visible = (int*)malloc(n * sizeof(int));
+    view->ahead = (float*)malloc(n * sizeof(float));
+    view->across = (float*)malloc(n * sizeof(float));
+    view->left = (int*)malloc(n * sizeof(int));
+    view->size = (int*)malloc(n * sizeof(int));
+    view->keys = (unsigned int*)malloc(n * sizeof(unsigned int));
+    view->order = (int*)malloc(n * sizeof(int));
+    view->sort_keys = (unsigned int*)malloc(n * sizeof(unsigned int));
+    view->sort_order = (int*)malloc(n * sizeof(int));
+    if (view->visible == NULL || view->ahead == NULL || view->across == NULL || view->left == NULL || view->size == NULL ||
+        view->keys == NULL || view->order == NULL || view->sort_keys == NULL || view->sort_order == NULL) {
+        sprite_view_free(view);
+        return -1;
+    }
+    view->capacity = (int)n;
+    view->x = sprite_x;
+    view->y = sprite_y;
+    return 0;
+}
+
+void sprite_view_free(sprite_view* view) {
+    free(view->visible);
+    free(view->ahead);
+    free(view->across);
+    free(view->left);
+    free(view->size);
+    free(view->keys);
+    free(view->order);
+    free(view->sort_keys);
+    free(view->sort_order);
+    free(view->tiles);
+    memset(view, 0, sizeof(sprite_view));
+}
+
+/* Sorts the visible sprites by depth from closest to furthest. The depths are all
+ * positive so the bits of the floats sort the same way as the floats themselves,
+ * which lets us do it a byte at a time without comparing anything. */
+static void sprite_sort(sprite_view* view, int count) {
+    unsigned int* keys = view->keys;
+    int* order = view->order;
+    int shift, i;
+
+    for (shift = 0; shift < 32; shift += SPRITE_RADIX_BITS) {
+        int offsets[SPRITE_RADIX_SIZE] = { 0 };
+        int total = 0;
+        unsigned int* swap_keys;
+        int* swap_order;
+
+        for (i = 0; i < count; i++)
+            offsets[(keys[i] >> shift) & (SPRITE_RADIX_SIZE - 1)]++;
+        for (i = 0; i < SPRITE_RADIX_SIZE; i++) {
+            int bucket = offsets[i];
+            offsets[i] = total;
+            total += bucket;
+        }
+        /* Anything that landed in the same bucket keeps the order it was in. */
+        for (i = 0; i < count; i++) {
+            int slot = offsets[(keys[i] >> shift) & (SPRITE_RADIX_SIZE - 1)]++;
+            view->sort_keys[slot] = keys[i];
+            view->sort_order[slot] = order[i];
+        }
+
+        swap_keys = keys;
+        keys = view->sort_keys;
+        view->sort_keys = swap_keys;
+        swap_order = order;
+        order = view->sort_order;
+        view->sort_order = swap_order;
+    }
+
+    /* An even number of passes means that the sorted results are back where they started. */
+    view->keys = keys;
+    view->order = order;
+}
+
+int sprite_cull(sprite_view* view, const ray_camera* camera, const float* depth, int width, int height) {
+    /* Undo the camera so that sprites can be measured along the view direction and across it. */
+    float inv_det = 1.0f / (camera->plane_x * camera->dir_y - camera->dir_x * camera->plane_y);
+    float max_light = shade_get_max_light();
+    int tiles = (width + SPRITE_DEPTH_TILE - 1) / SPRITE_DEPTH_TILE;
+    int count = 0;
+    int i, t;
+
+    view->count = 0;
+    if (sprite_count == 0)
+        return 0;
+
+    for (i = 0; i < sprite_count; i++) {
+        float rel_x = view->x[i] - camera->x;
+        float rel_y = view->y[i] - camera->y;
+        view->ahead[i] = inv_det * (camera->plane_x * rel_y - camera->plane_y * rel_x);
+        view->across[i] = inv_det * (camera->dir_y * rel_x - camera->dir_x * rel_y);
+    }
+
+    /* The furthest wall in each tile. A sprite that is behind that in every tile it covers
+     * cannot be seen anywhere. */
+    if (tiles > view->tile_count) {
+        float* grown = (float*)realloc(view->tiles, (size_t)tiles * sizeof(float));
+        if (grown == NULL)
+            return 0;
+        view->tiles = grown;
+        view->tile_count = tiles;
+    }
+    for (t = 0; t < tiles; t++) {
+        int x;
+        view->tiles[t] = 0.0f;
+        for (x = t * SPRITE_DEPTH_TILE; x < width && x < (t + 1) * SPRITE_DEPTH_TILE; x++) {
+            if (depth[x] > view->tiles[t])
+                view->tiles[t] = depth[x];
+        }
+    }
+
+    for (i = 0; i < sprite_count; i++) {
+        float ahead = view->ahead[i];
+        float center, size;
+        int left, right, first, last;
+
+        /* Behind the camera or so far away that it would be drawn black anyway. */
+        if (!(ahead > SPRITE_NEAR) || ahead >= max_light)
+            continue;
+
+        /* Off either side of the screen. This is all done before converting to integers
+         * since a sprite far off to the side can be a very long way off the screen. */
+        size = (float)height / ahead;
+        center = (float)width / 2.0f * (1.0f + view->across[i] / ahead);
+        if (center + size / 2.0f <= 0.0f || center - size / 2.0f >= (float)width)
+            continue;
+        left = (int)center - (int)size / 2;
+        right = left + (int)size;
+        if (right <= 0 || left >= width || (int)size <= 0)
+            continue;
+
+        /* Hidden behind the walls. */
+        first = (left > 0 ? left : 0) / SPRITE_DEPTH_TILE;
+        last = ((right < width ? right : width) - 1) / SPRITE_DEPTH_TILE;
+        for (t = first; t <= last && view->tiles[t] <= ahead; t++)
+            ;
+        if (t > last)
+            continue;
+
+        memcpy(&view->keys[count], &ahead, sizeof(float));
+        view->order[count] = i;
+        view->left[i] = left;
+        view->size[i] = (int)size;
+        count++;
+    }
+
+    /* Lay the survivors out furthest first. */
+    sprite_sort(view, count);
+    for (i = 0; i < count; i++)
+        view->visible[i] = view->order[count - 1 - i];
+    view->count = count;
+    return count;
+}
+
+void sprite_draw(const sprite_view* view, gfx_color* pixels, int pitch, const float* depth, int width, int height, int begin, int end) {
+    int v, x;
+
+    if (end > width)
+        end = width;
+
+    for (v = 0; v < view->count; v++) {
+        int sprite = view->visible[v];
+        int left = view->left[sprite];
+        int size = view->size[sprite];
+        float ahead = view->ahead[sprite];
+        int bitmap = sprite_bitmap[sprite];
+        int first = left > begin ? left : begin;
+        int last = left + size < end ? left + size : end;
+        int top, start, stop, level, levels, bitmap_width, bitmap_height, shade_level;
+        const unsigned char* shade;
+        column_kernel kernel;
+        float bitmap_step;
+
+        if (first >= last)
+            continue;
+
+        /* Pick a mip level the same way as the walls do. */
+        levels = gfx_get_bitmap_levels(bitmap);
+        bitmap_width = gfx_get_bitmap_width(bitmap);
+        bitmap_height = gfx_get_bitmap_height(bitmap);
+        level = 0;
+        while (level + 1 < levels && GFX_MIP_SIZE(bitmap_height, level) / 2 >= size)
+            level++;
+        bitmap_width = GFX_MIP_SIZE(bitmap_width, level);
+        bitmap_height = GFX_MIP_SIZE(bitmap_height, level);
+        bitmap_step = (float)bitmap_height / (float)size;
+        shade_level = shade_get_level(ahead);
+        shade = shade_get_table(shade_level);
+        kernel = column_get(bitmap, level, COLUMN_LIGHT(shade_level));
+        if (kernel == NULL)
+            continue;
+
+        /* Sprites stand in the middle of the screen like the walls do. */
+        top = height / 2 - size / 2;
+        start = top > 0 ? top : 0;
+        stop = top + size < height ? top + size : height;
+
+        for (x = first; x < last; x++) {
+            const gfx_color* column;
+
+            /* Only where the sprite is in front of the wall. */
+            if (depth[x] <= ahead)
+                continue;
+            column = gfx_get_bitmap_mip_column(bitmap, level, (x - left) * bitmap_width / size);
+            if (column == NULL)
+                continue;
+
+            /* The see through parts of the sprite leave whatever is behind it. */
+            if (start < stop)
+                kernel(pixels + start * pitch + x, pitch, stop - start, column, (float)(start - top) * bitmap_step, bitmap_step, shade);
+        }
+    }
+}
\ No newline at end of file